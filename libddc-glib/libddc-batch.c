@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-batch
+ * @short_description: Runs many control operations on one device
+ *
+ * Applying a profile means setting or reading many controls in one go.
+ * A batch collects the operations, resolves every control once and then
+ * sends the commands back to back, only waiting as long as the display
+ * needs between frames. Each operation gets its own result, so one
+ * unsupported control does not stop the rest of the profile.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <string.h>
+
+#include <libddc-batch.h>
+#include <libddc-control.h>
+#include <libddc-device.h>
+
+static void     libddc_batch_finalize	(GObject     *object);
+
+#define LIBDDC_BATCH_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_BATCH, LibddcBatchPrivate))
+
+/**
+ * LibddcBatchPrivate:
+ *
+ * Private #LibddcBatch data
+ **/
+struct _LibddcBatchPrivate
+{
+	LibddcDevice		*device;
+	GArray			*results;
+};
+
+G_DEFINE_TYPE (LibddcBatch, libddc_batch, G_TYPE_OBJECT)
+
+/**
+ * libddc_batch_add:
+ **/
+static guint
+libddc_batch_add (LibddcBatch *batch, LibddcBatchKind kind, guchar id, guint16 value)
+{
+	LibddcBatchResult result;
+
+	result.kind = kind;
+	result.id = id;
+	result.value = value;
+	result.maximum = 0;
+	result.error = NULL;
+	g_array_append_val (batch->priv->results, result);
+	return batch->priv->results->len - 1;
+}
+
+/**
+ * libddc_batch_add_get:
+ * @batch: a #LibddcBatch
+ * @id: the control ID
+ *
+ * Adds a request for the current and maximum value of a control.
+ *
+ * Return value: the index of the operation in the results
+ *
+ * Since: 0.0.1
+ **/
+guint
+libddc_batch_add_get (LibddcBatch *batch, guchar id)
+{
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), G_MAXUINT);
+	return libddc_batch_add (batch, LIBDDC_BATCH_KIND_GET, id, 0);
+}
+
+/**
+ * libddc_batch_add_set:
+ * @batch: a #LibddcBatch
+ * @id: the control ID
+ * @value: the new value
+ *
+ * Adds a write of a new control value.
+ *
+ * Return value: the index of the operation in the results
+ *
+ * Since: 0.0.1
+ **/
+guint
+libddc_batch_add_set (LibddcBatch *batch, guchar id, guint16 value)
+{
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), G_MAXUINT);
+	return libddc_batch_add (batch, LIBDDC_BATCH_KIND_SET, id, value);
+}
+
+/**
+ * libddc_batch_add_reset:
+ * @batch: a #LibddcBatch
+ * @id: the control ID
+ *
+ * Adds a reset of a control to the factory default.
+ *
+ * Return value: the index of the operation in the results
+ *
+ * Since: 0.0.1
+ **/
+guint
+libddc_batch_add_reset (LibddcBatch *batch, guchar id)
+{
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), G_MAXUINT);
+	return libddc_batch_add (batch, LIBDDC_BATCH_KIND_RESET, id, 0);
+}
+
+/**
+ * libddc_batch_execute:
+ * @batch: a #LibddcBatch
+ * @error: a #GError, or %NULL
+ *
+ * Runs every operation in the order it was added. A failure of a single
+ * operation is recorded in its result and the batch carries on.
+ *
+ * Each operation is the same blocking call that would be made by hand,
+ * so the bus traffic is unchanged and only the control lookups are saved.
+ *
+ * Return value: %FALSE if the controls of the device could not be read
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_batch_execute (LibddcBatch *batch, GError **error)
+{
+	gboolean ret = FALSE;
+	guint i;
+	GPtrArray *controls;
+	LibddcBatchResult *result;
+	LibddcControl *control;
+	LibddcControl *by_id[256];
+
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* resolve every control once rather than once per operation */
+	controls = libddc_device_get_controls (batch->priv->device, error);
+	if (controls == NULL)
+		goto out;
+	memset (by_id, 0, sizeof(by_id));
+	for (i=0; i<controls->len; i++) {
+		control = g_ptr_array_index (controls, i);
+		by_id[libddc_control_get_id (control)] = control;
+	}
+
+	for (i=0; i<batch->priv->results->len; i++) {
+		result = &g_array_index (batch->priv->results, LibddcBatchResult, i);
+		g_clear_error (&result->error);
+
+		control = by_id[result->id];
+		if (control == NULL) {
+			g_set_error (&result->error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+				     "could not find a control id 0x%02x", (guint) result->id);
+			continue;
+		}
+
+		/* the device only waits as long as the last command needs */
+		switch (result->kind) {
+		case LIBDDC_BATCH_KIND_GET:
+			libddc_control_request (control, &result->value, &result->maximum, &result->error);
+			break;
+		case LIBDDC_BATCH_KIND_SET:
+			libddc_control_set (control, result->value, &result->error);
+			break;
+		case LIBDDC_BATCH_KIND_RESET:
+			libddc_control_reset (control, &result->error);
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+	g_ptr_array_unref (controls);
+	ret = TRUE;
+out:
+	return ret;
+}
+
+/**
+ * libddc_batch_get_results:
+ * @batch: a #LibddcBatch
+ *
+ * Return value: (transfer none): an array of #LibddcBatchResult in the
+ * order the operations were added
+ *
+ * Since: 0.0.1
+ **/
+GArray *
+libddc_batch_get_results (LibddcBatch *batch)
+{
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), NULL);
+	return batch->priv->results;
+}
+
+/**
+ * libddc_batch_get_failed:
+ * @batch: a #LibddcBatch
+ *
+ * Return value: the number of operations that failed in the last execute
+ *
+ * Since: 0.0.1
+ **/
+guint
+libddc_batch_get_failed (LibddcBatch *batch)
+{
+	guint i;
+	guint failed = 0;
+	LibddcBatchResult *result;
+
+	g_return_val_if_fail (LIBDDC_IS_BATCH(batch), 0);
+
+	for (i=0; i<batch->priv->results->len; i++) {
+		result = &g_array_index (batch->priv->results, LibddcBatchResult, i);
+		if (result->error != NULL)
+			failed++;
+	}
+	return failed;
+}
+
+/**
+ * libddc_batch_result_clear:
+ **/
+static void
+libddc_batch_result_clear (gpointer data)
+{
+	LibddcBatchResult *result = (LibddcBatchResult *) data;
+	g_clear_error (&result->error);
+}
+
+/**
+ * libddc_batch_class_init:
+ **/
+static void
+libddc_batch_class_init (LibddcBatchClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_batch_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcBatchPrivate));
+}
+
+/**
+ * libddc_batch_init:
+ **/
+static void
+libddc_batch_init (LibddcBatch *batch)
+{
+	batch->priv = LIBDDC_BATCH_GET_PRIVATE (batch);
+	batch->priv->results = g_array_new (FALSE, FALSE, sizeof(LibddcBatchResult));
+	g_array_set_clear_func (batch->priv->results, libddc_batch_result_clear);
+}
+
+/**
+ * libddc_batch_finalize:
+ **/
+static void
+libddc_batch_finalize (GObject *object)
+{
+	LibddcBatch *batch = LIBDDC_BATCH (object);
+	LibddcBatchPrivate *priv = batch->priv;
+
+	g_return_if_fail (LIBDDC_IS_BATCH(batch));
+
+	g_array_unref (priv->results);
+	if (priv->device != NULL)
+		g_object_unref (priv->device);
+
+	G_OBJECT_CLASS (libddc_batch_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_batch_new:
+ * @device: a #LibddcDevice
+ *
+ * Return value: A new %LibddcBatch instance for @device
+ *
+ * Since: 0.0.1
+ **/
+LibddcBatch *
+libddc_batch_new (LibddcDevice *device)
+{
+	LibddcBatch *batch;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+
+	batch = g_object_new (LIBDDC_TYPE_BATCH, NULL);
+	batch->priv->device = g_object_ref (device);
+	return LIBDDC_BATCH (batch);
+}
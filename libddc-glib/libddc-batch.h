@@ -0,0 +1,113 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_BATCH_H
+#define __LIBDDC_BATCH_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+#include <libddc-device.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_BATCH		(libddc_batch_get_type ())
+#define LIBDDC_BATCH(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_BATCH, LibddcBatch))
+#define LIBDDC_BATCH_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_BATCH, LibddcBatchClass))
+#define LIBDDC_IS_BATCH(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_BATCH))
+#define LIBDDC_IS_BATCH_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_BATCH))
+#define LIBDDC_BATCH_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_BATCH, LibddcBatchClass))
+
+/**
+ * LibddcBatchKind:
+ * @LIBDDC_BATCH_KIND_GET: read the current and maximum value
+ * @LIBDDC_BATCH_KIND_SET: write a new value
+ * @LIBDDC_BATCH_KIND_RESET: reset the control to the factory default
+ *
+ * The type of each operation in a batch
+ */
+typedef enum {
+	LIBDDC_BATCH_KIND_GET,
+	LIBDDC_BATCH_KIND_SET,
+	LIBDDC_BATCH_KIND_RESET
+} LibddcBatchKind;
+
+/**
+ * LibddcBatchResult:
+ * @kind: the type of operation
+ * @id: the control ID
+ * @value: the value that was read, or the value to write
+ * @maximum: the maximum value that was read
+ * @error: the reason this operation failed, or %NULL for success
+ *
+ * One operation in a batch and its outcome
+ */
+typedef struct {
+	LibddcBatchKind		 kind;
+	guchar			 id;
+	guint16			 value;
+	guint16			 maximum;
+	GError			*error;
+} LibddcBatchResult;
+
+typedef struct _LibddcBatchPrivate		LibddcBatchPrivate;
+typedef struct _LibddcBatch			LibddcBatch;
+typedef struct _LibddcBatchClass		LibddcBatchClass;
+
+struct _LibddcBatch
+{
+	 GObject		 parent;
+	 LibddcBatchPrivate	*priv;
+};
+
+struct _LibddcBatchClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GType		 libddc_batch_get_type			(void);
+LibddcBatch	*libddc_batch_new			(LibddcDevice	*device);
+
+guint		 libddc_batch_add_get			(LibddcBatch	*batch,
+							 guchar		 id);
+guint		 libddc_batch_add_set			(LibddcBatch	*batch,
+							 guchar		 id,
+							 guint16	 value);
+guint		 libddc_batch_add_reset			(LibddcBatch	*batch,
+							 guchar		 id);
+gboolean	 libddc_batch_execute			(LibddcBatch	*batch,
+							 GError		**error);
+GArray		*libddc_batch_get_results		(LibddcBatch	*batch);
+guint		 libddc_batch_get_failed		(LibddcBatch	*batch);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_BATCH_H */
@@ -0,0 +1,688 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libddc-batch.h"
+#include "libddc-device.h"
+#include "libddc-scheduler.h"
+#include "libddc-simulator.h"
+
+#define LIBDDC_BENCH_ITERATIONS		20
+#define LIBDDC_BENCH_BUSES		4
+
+/* capabilities strings from many displays, including broken ones */
+static const gchar *libddc_bench_corpus = TESTDATADIR "/capabilities.txt";
+
+/* the same profile the self test applies, twenty different controls */
+static const guchar libddc_bench_profile[] = {
+	0x10, 0x12, 0x16, 0x18, 0x1a, 0x59, 0x5a, 0x5b, 0x5c, 0x5d,
+	0x5e, 0x62, 0x6c, 0x6e, 0x70, 0x87, 0x8a, 0x8f, 0x90, 0x91 };
+#define LIBDDC_BENCH_PROFILE_CAPS	"(prot(monitor)type(lcd)model(PROFILE)" \
+					"vcp(10 12 16 18 1A 59 5A 5B 5C 5D 5E 62 " \
+					"6C 6E 70 87 8A 8F 90 91))"
+
+typedef struct {
+	LibddcDevice		*device;
+	LibddcSimulator		*simulator;
+	gboolean		 ret;
+	GError			*error;
+} LibddcBenchBus;
+
+typedef struct {
+	GMainLoop		*loop;
+	guint			 pending;
+	GError			*error;
+} LibddcBenchRound;
+
+typedef gboolean (*LibddcBenchFunc)	(guint		 iterations,
+					 guint		 buses,
+					 GArray		*samples,
+					 GError		**error);
+
+typedef struct {
+	const gchar		*name;
+	LibddcBenchFunc		 func;
+	gboolean		 uses_buses;
+} LibddcBenchScenario;
+
+/**
+ * libddc_bench_bus_new:
+ **/
+static LibddcBenchBus *
+libddc_bench_bus_new (void)
+{
+	LibddcBenchBus *bus;
+
+	bus = g_new0 (LibddcBenchBus, 1);
+	bus->simulator = libddc_simulator_new ();
+	bus->device = libddc_device_new ();
+	libddc_simulator_attach (bus->simulator, bus->device);
+
+	/* always talk to the display so every run does the same work */
+	libddc_device_set_use_cache (bus->device, FALSE);
+	return bus;
+}
+
+/**
+ * libddc_bench_bus_set_profile:
+ *
+ * The default simulated display has too few controls for the profile
+ **/
+static void
+libddc_bench_bus_set_profile (LibddcBenchBus *bus)
+{
+	guint i;
+
+	libddc_simulator_set_caps (bus->simulator, LIBDDC_BENCH_PROFILE_CAPS);
+	for (i=0; i<G_N_ELEMENTS(libddc_bench_profile); i++)
+		libddc_simulator_set_vcp (bus->simulator, libddc_bench_profile[i], 50, 100);
+}
+
+/**
+ * libddc_bench_bus_free:
+ **/
+static void
+libddc_bench_bus_free (LibddcBenchBus *bus)
+{
+	if (bus->error != NULL)
+		g_error_free (bus->error);
+	g_object_unref (bus->device);
+	g_object_unref (bus->simulator);
+	g_free (bus);
+}
+
+/**
+ * libddc_bench_coldplug_thread_cb:
+ **/
+static void
+libddc_bench_coldplug_thread_cb (gpointer data, gpointer user_data)
+{
+	LibddcBenchBus *bus = (LibddcBenchBus *) data;
+
+	/* this is what the client does for each bus it finds */
+	bus->ret = libddc_device_open (bus->device, "simulator", &bus->error);
+	if (!bus->ret)
+		return;
+	bus->ret = (libddc_device_get_edid_md5 (bus->device, &bus->error) != NULL);
+}
+
+/**
+ * libddc_bench_coldplug:
+ *
+ * Opens every bus at the same time and reads the EDID, like
+ * libddc_client_get_devices() does for the buses wired to a connector.
+ **/
+static gboolean
+libddc_bench_coldplug (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = TRUE;
+	gint64 start;
+	gint64 elapsed;
+	guint i, j;
+	GPtrArray *array;
+	GThreadPool *pool;
+	LibddcBenchBus *bus;
+
+	for (i=0; i<iterations && ret; i++) {
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) libddc_bench_bus_free);
+		for (j=0; j<buses; j++)
+			g_ptr_array_add (array, libddc_bench_bus_new ());
+
+		start = g_get_monotonic_time ();
+		pool = g_thread_pool_new (libddc_bench_coldplug_thread_cb, NULL, buses, FALSE, error);
+		if (pool == NULL) {
+			ret = FALSE;
+			g_ptr_array_unref (array);
+			break;
+		}
+		for (j=0; j<buses; j++)
+			g_thread_pool_push (pool, g_ptr_array_index (array, j), NULL);
+		g_thread_pool_free (pool, FALSE, TRUE);
+		elapsed = g_get_monotonic_time () - start;
+		g_array_append_val (samples, elapsed);
+
+		/* every bus has to have worked */
+		for (j=0; j<buses; j++) {
+			bus = g_ptr_array_index (array, j);
+			if (!bus->ret) {
+				ret = FALSE;
+				g_propagate_error (error, bus->error);
+				bus->error = NULL;
+				break;
+			}
+		}
+		g_ptr_array_unref (array);
+	}
+	return ret;
+}
+
+/**
+ * libddc_bench_caps:
+ **/
+static gboolean
+libddc_bench_caps (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = TRUE;
+	gint64 start;
+	gint64 elapsed;
+	guint i;
+	GPtrArray *controls;
+	LibddcBenchBus *bus;
+
+	for (i=0; i<iterations && ret; i++) {
+		bus = libddc_bench_bus_new ();
+		ret = libddc_device_open (bus->device, "simulator", error);
+		if (!ret) {
+			libddc_bench_bus_free (bus);
+			break;
+		}
+		start = g_get_monotonic_time ();
+		controls = libddc_device_get_controls (bus->device, error);
+		elapsed = g_get_monotonic_time () - start;
+		if (controls == NULL) {
+			ret = FALSE;
+		} else {
+			g_array_append_val (samples, elapsed);
+			g_ptr_array_unref (controls);
+		}
+		libddc_bench_bus_free (bus);
+	}
+	return ret;
+}
+
+/**
+ * libddc_bench_open_control:
+ **/
+static LibddcControl *
+libddc_bench_open_control (LibddcBenchBus *bus, guchar id, GError **error)
+{
+	LibddcControl *control = NULL;
+
+	if (!libddc_device_open (bus->device, "simulator", error))
+		goto out;
+	control = libddc_device_get_control_by_id (bus->device, id, error);
+out:
+	return control;
+}
+
+/**
+ * libddc_bench_request_loop:
+ **/
+static gboolean
+libddc_bench_request_loop (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = FALSE;
+	gint64 start;
+	gint64 elapsed;
+	guint i;
+	guint16 value;
+	LibddcBenchBus *bus;
+	LibddcControl *control;
+
+	bus = libddc_bench_bus_new ();
+	control = libddc_bench_open_control (bus, LIBDDC_CONTROL_ID_BRIGHTNESS, error);
+	if (control == NULL)
+		goto out;
+	for (i=0; i<iterations; i++) {
+		start = g_get_monotonic_time ();
+		ret = libddc_control_request (control, &value, NULL, error);
+		elapsed = g_get_monotonic_time () - start;
+		if (!ret)
+			break;
+		g_array_append_val (samples, elapsed);
+	}
+	g_object_unref (control);
+out:
+	libddc_bench_bus_free (bus);
+	return ret;
+}
+
+/**
+ * libddc_bench_set_loop:
+ **/
+static gboolean
+libddc_bench_set_loop (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = FALSE;
+	gint64 start;
+	gint64 elapsed;
+	guint i;
+	LibddcBenchBus *bus;
+	LibddcControl *control;
+
+	bus = libddc_bench_bus_new ();
+	control = libddc_bench_open_control (bus, LIBDDC_CONTROL_ID_BRIGHTNESS, error);
+	if (control == NULL)
+		goto out;
+	for (i=0; i<iterations; i++) {
+		start = g_get_monotonic_time ();
+		ret = libddc_control_set (control, 40 + (i % 2) * 20, error);
+		elapsed = g_get_monotonic_time () - start;
+		if (!ret)
+			break;
+		g_array_append_val (samples, elapsed);
+	}
+	g_object_unref (control);
+out:
+	libddc_bench_bus_free (bus);
+	return ret;
+}
+
+/**
+ * libddc_bench_profile_apply:
+ **/
+static gboolean
+libddc_bench_profile_apply (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = FALSE;
+	gint64 start;
+	gint64 elapsed;
+	guint i;
+	LibddcBatch *batch = NULL;
+	LibddcBenchBus *bus;
+	GPtrArray *controls;
+
+	bus = libddc_bench_bus_new ();
+	libddc_bench_bus_set_profile (bus);
+	ret = libddc_device_open (bus->device, "simulator", error);
+	if (!ret)
+		goto out;
+
+	/* the capabilities are not part of applying a profile */
+	controls = libddc_device_get_controls (bus->device, error);
+	if (controls == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+	g_ptr_array_unref (controls);
+
+	batch = libddc_batch_new (bus->device);
+	for (i=0; i<G_N_ELEMENTS(libddc_bench_profile); i++)
+		libddc_batch_add_set (batch, libddc_bench_profile[i], 20 + i);
+	for (i=0; i<iterations; i++) {
+		start = g_get_monotonic_time ();
+		ret = libddc_batch_execute (batch, error);
+		elapsed = g_get_monotonic_time () - start;
+		if (!ret)
+			break;
+		if (libddc_batch_get_failed (batch) > 0) {
+			ret = FALSE;
+			g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+				     "%u profile operations failed",
+				     libddc_batch_get_failed (batch));
+			break;
+		}
+		g_array_append_val (samples, elapsed);
+	}
+out:
+	if (batch != NULL)
+		g_object_unref (batch);
+	libddc_bench_bus_free (bus);
+	return ret;
+}
+
+/**
+ * libddc_bench_profile_loop:
+ *
+ * The same profile as profile-apply, one libddc_control_set() at a time.
+ **/
+static gboolean
+libddc_bench_profile_loop (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = FALSE;
+	gint64 start;
+	gint64 elapsed;
+	guint i;
+	guint j;
+	LibddcBenchBus *bus;
+	LibddcControl *control;
+	GPtrArray *controls;
+
+	bus = libddc_bench_bus_new ();
+	libddc_bench_bus_set_profile (bus);
+	controls = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	ret = libddc_device_open (bus->device, "simulator", error);
+	if (!ret)
+		goto out;
+
+	/* looking up the controls is not part of applying a profile */
+	for (i=0; i<G_N_ELEMENTS(libddc_bench_profile); i++) {
+		control = libddc_device_get_control_by_id (bus->device, libddc_bench_profile[i], error);
+		if (control == NULL) {
+			ret = FALSE;
+			goto out;
+		}
+		g_ptr_array_add (controls, control);
+	}
+
+	for (i=0; i<iterations; i++) {
+		start = g_get_monotonic_time ();
+		for (j=0; j<controls->len; j++) {
+			ret = libddc_control_set (g_ptr_array_index (controls, j), 20 + j, error);
+			if (!ret)
+				goto out;
+		}
+		elapsed = g_get_monotonic_time () - start;
+		g_array_append_val (samples, elapsed);
+	}
+out:
+	g_ptr_array_unref (controls);
+	libddc_bench_bus_free (bus);
+	return ret;
+}
+
+/**
+ * libddc_bench_scheduler_cb:
+ **/
+static void
+libddc_bench_scheduler_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *reply;
+	GError *error = NULL;
+	LibddcBenchRound *pass = (LibddcBenchRound *) user_data;
+
+	reply = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (reply == NULL) {
+		if (pass->error == NULL)
+			pass->error = error;
+		else
+			g_error_free (error);
+	} else {
+		g_bytes_unref (reply);
+	}
+	if (--pass->pending == 0)
+		g_main_loop_quit (pass->loop);
+}
+
+/**
+ * libddc_bench_scheduler:
+ *
+ * Sends one request to every bus at the same time from one main loop,
+ * which is one operation. The waits on different buses overlap, so the
+ * latency should stay flat as --buses grows.
+ **/
+static gboolean
+libddc_bench_scheduler (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret = TRUE;
+	gint64 start;
+	gint64 elapsed;
+	guint i, j;
+	GPtrArray *array;
+	LibddcBenchBus *bus;
+	LibddcBenchRound pass;
+	LibddcScheduler *scheduler;
+	const guchar buf[] = { LIBDDC_VCP_REQUEST, LIBDDC_CONTROL_ID_BRIGHTNESS };
+
+	scheduler = libddc_scheduler_new ();
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) libddc_bench_bus_free);
+	for (j=0; j<buses && ret; j++) {
+		bus = libddc_bench_bus_new ();
+		g_ptr_array_add (array, bus);
+		ret = libddc_device_open (bus->device, "simulator", error);
+		if (!ret)
+			break;
+
+		/* the first command would fetch the capabilities */
+		ret = libddc_device_ensure_startup (bus->device, error);
+		if (ret)
+			libddc_scheduler_add_device (scheduler, bus->device);
+	}
+
+	pass.loop = g_main_loop_new (NULL, FALSE);
+	pass.error = NULL;
+	for (i=0; i<iterations && ret; i++) {
+		pass.pending = array->len;
+		start = g_get_monotonic_time ();
+		for (j=0; j<array->len; j++) {
+			bus = g_ptr_array_index (array, j);
+			libddc_device_command_async (bus->device, buf, sizeof(buf), 8, NULL,
+						     libddc_bench_scheduler_cb, &pass);
+		}
+		g_main_loop_run (pass.loop);
+		elapsed = g_get_monotonic_time () - start;
+		if (pass.error != NULL) {
+			ret = FALSE;
+			g_propagate_error (error, pass.error);
+			break;
+		}
+		g_array_append_val (samples, elapsed);
+	}
+
+	for (j=0; j<array->len; j++) {
+		bus = g_ptr_array_index (array, j);
+		libddc_scheduler_remove_device (scheduler, bus->device);
+	}
+	g_main_loop_unref (pass.loop);
+	g_ptr_array_unref (array);
+	g_object_unref (scheduler);
+	return ret;
+}
+
+/**
+ * libddc_bench_caps_parse:
+ *
+ * Parses every string in the corpus, which is one operation. No bus is
+ * used, so this is the cost of the parser alone.
+ **/
+static gboolean
+libddc_bench_caps_parse (guint iterations, guint buses, GArray *samples, GError **error)
+{
+	gboolean ret;
+	gchar *data = NULL;
+	gchar *tab;
+	gchar **lines = NULL;
+	gint64 start;
+	gint64 elapsed;
+	guint i, j;
+	GPtrArray *corpus;
+	LibddcDevice *device;
+
+	corpus = g_ptr_array_new_with_free_func (g_free);
+	device = libddc_device_new ();
+	ret = g_file_get_contents (libddc_bench_corpus, &data, NULL, error);
+	if (!ret)
+		goto out;
+	lines = g_strsplit (data, "\n", -1);
+	for (i=0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0' || lines[i][0] == '#')
+			continue;
+		tab = strchr (lines[i], '\t');
+		if (tab == NULL)
+			continue;
+		g_ptr_array_add (corpus, g_strcompress (tab + 1));
+	}
+	if (corpus->len == 0) {
+		ret = FALSE;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "no capabilities strings in %s", libddc_bench_corpus);
+		goto out;
+	}
+
+	/* some of the strings are meant to be rejected */
+	for (i=0; i<iterations; i++) {
+		start = g_get_monotonic_time ();
+		for (j=0; j<corpus->len; j++)
+			libddc_device_set_capabilities (device, g_ptr_array_index (corpus, j), NULL);
+		elapsed = g_get_monotonic_time () - start;
+		g_array_append_val (samples, elapsed);
+	}
+out:
+	g_strfreev (lines);
+	g_free (data);
+	g_ptr_array_unref (corpus);
+	g_object_unref (device);
+	return ret;
+}
+
+static const LibddcBenchScenario libddc_bench_scenarios[] = {
+	{ "coldplug",		libddc_bench_coldplug,		TRUE },
+	{ "caps",		libddc_bench_caps,		FALSE },
+	{ "request-loop",	libddc_bench_request_loop,	FALSE },
+	{ "set-loop",		libddc_bench_set_loop,		FALSE },
+	{ "profile-apply",	libddc_bench_profile_apply,	FALSE },
+	{ "profile-loop",	libddc_bench_profile_loop,	FALSE },
+	{ "scheduler",		libddc_bench_scheduler,		TRUE },
+	{ "caps-parse",		libddc_bench_caps_parse,	FALSE },
+	{ NULL,			NULL,				FALSE }
+};
+
+/**
+ * libddc_bench_sort_cb:
+ **/
+static gint
+libddc_bench_sort_cb (gconstpointer a, gconstpointer b)
+{
+	gint64 sample_a = *((const gint64 *) a);
+	gint64 sample_b = *((const gint64 *) b);
+	if (sample_a < sample_b)
+		return -1;
+	if (sample_a > sample_b)
+		return 1;
+	return 0;
+}
+
+/**
+ * libddc_bench_percentile:
+ *
+ * Return value: the nearest-rank percentile of the sorted samples
+ **/
+static gint64
+libddc_bench_percentile (GArray *samples, guint percent)
+{
+	guint rank;
+
+	rank = (samples->len * percent + 99) / 100;
+	if (rank == 0)
+		rank = 1;
+	return g_array_index (samples, gint64, rank - 1);
+}
+
+/**
+ * libddc_bench_print:
+ *
+ * Each sample of a scenario using several buses is one round with an
+ * operation on every bus, so the percentiles are per round but the rate
+ * counts every bus to show how well it scales.
+ **/
+static void
+libddc_bench_print (const LibddcBenchScenario *scenario, guint buses, GArray *samples)
+{
+	guint i;
+	guint ops;
+	gint64 total = 0;
+
+	g_array_sort (samples, libddc_bench_sort_cb);
+	for (i=0; i<samples->len; i++)
+		total += g_array_index (samples, gint64, i);
+	ops = samples->len;
+	if (scenario->uses_buses)
+		ops *= buses;
+	g_print ("scenario=%s ops=%u", scenario->name, ops);
+	if (scenario->uses_buses)
+		g_print (" buses=%u", buses);
+	g_print (" ops_per_sec=%.2f p50_us=%" G_GINT64_FORMAT " p99_us=%" G_GINT64_FORMAT "\n",
+		 total > 0 ? (gdouble) ops * G_USEC_PER_SEC / total : 0.0f,
+		 libddc_bench_percentile (samples, 50),
+		 libddc_bench_percentile (samples, 99));
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char **argv)
+{
+	gboolean ret;
+	gboolean any_found = FALSE;
+	gint retval = EXIT_SUCCESS;
+	gint iterations = LIBDDC_BENCH_ITERATIONS;
+	gint buses = LIBDDC_BENCH_BUSES;
+	gchar *scenario = NULL;
+	gchar *corpus = NULL;
+	guint i;
+	GArray *samples;
+	GError *error = NULL;
+	GOptionContext *context;
+
+	const GOptionEntry options[] = {
+		{ "iterations", '\0', 0, G_OPTION_ARG_INT, &iterations,
+		  "Number of operations in each scenario", NULL},
+		{ "buses", '\0', 0, G_OPTION_ARG_INT, &buses,
+		  "Number of simulated buses to coldplug or schedule", NULL},
+		{ "scenario", '\0', 0, G_OPTION_ARG_STRING, &scenario,
+		  "Only run one scenario, e.g. 'request-loop'", NULL},
+		{ "corpus", '\0', 0, G_OPTION_ARG_FILENAME, &corpus,
+		  "Capabilities strings to parse, one per line after a tab", NULL},
+		{ NULL}
+	};
+
+	g_type_init ();
+
+	context = g_option_context_new ("DDC/CI benchmark program");
+	g_option_context_set_summary (context, "This runs the protocol engine against a simulated display.");
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_parse (context, &argc, &argv, NULL);
+	g_option_context_free (context);
+	if (corpus != NULL)
+		libddc_bench_corpus = corpus;
+	if (iterations < 1 || buses < 1) {
+		g_warning ("iterations and buses have to be positive");
+		retval = EXIT_FAILURE;
+		goto out;
+	}
+
+	/* do not touch the real cache, or use timings calibrated earlier */
+	g_setenv ("XDG_CACHE_HOME", "/tmp/libddc-bench", TRUE);
+	g_unlink ("/tmp/libddc-bench/libddc/capabilities.conf");
+	g_unlink ("/tmp/libddc-bench/libddc/timings.conf");
+
+	for (i=0; libddc_bench_scenarios[i].name != NULL; i++) {
+		if (scenario != NULL && g_strcmp0 (scenario, libddc_bench_scenarios[i].name) != 0)
+			continue;
+		any_found = TRUE;
+		samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+		ret = libddc_bench_scenarios[i].func (iterations, buses, samples, &error);
+		if (!ret) {
+			g_warning ("%s failed: %s", libddc_bench_scenarios[i].name, error->message);
+			g_clear_error (&error);
+			retval = EXIT_FAILURE;
+		} else {
+			libddc_bench_print (&libddc_bench_scenarios[i], buses, samples);
+		}
+		g_array_unref (samples);
+	}
+	if (!any_found) {
+		g_warning ("no scenario called %s", scenario);
+		retval = EXIT_FAILURE;
+	}
+out:
+	g_free (scenario);
+	g_free (corpus);
+	return retval;
+}
+
@@ -30,6 +30,7 @@
 
 #include <glib-object.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <libddc-client.h>
 #include <libddc-device.h>
@@ -58,6 +59,259 @@ enum {
 
 G_DEFINE_TYPE (LibddcClient, libddc_client, G_TYPE_OBJECT)
 
+/* the number of buses probed at the same time */
+#define LIBDDC_CLIENT_MAX_THREADS	4
+
+#define LIBDDC_CLIENT_SYSFS_DRM		"/sys/class/drm"
+#define LIBDDC_CLIENT_SYSFS_I2C		"/sys/bus/i2c/devices"
+
+/**
+ * LibddcClientJob:
+ *
+ * One bus being opened or closed on the worker pool
+ **/
+typedef struct {
+	guint			 bus;
+	gchar			*filename;
+	gchar			*connector;
+	LibddcDevice		*device;
+	gboolean		 ret;
+	GError			*error;
+} LibddcClientJob;
+
+/**
+ * libddc_client_job_free:
+ **/
+static void
+libddc_client_job_free (LibddcClientJob *job)
+{
+	g_free (job->filename);
+	g_free (job->connector);
+	if (job->device != NULL)
+		g_object_unref (job->device);
+	if (job->error != NULL)
+		g_error_free (job->error);
+	g_free (job);
+}
+
+/**
+ * libddc_client_open_thread_cb:
+ **/
+static void
+libddc_client_open_thread_cb (gpointer data, gpointer user_data)
+{
+	LibddcClientJob *job = (LibddcClientJob *) data;
+	job->ret = libddc_device_open (job->device, job->filename, &job->error);
+
+	/* opening never talks to the bus, so check something answers; buses
+	 * from DRM connectors are already known to have a display */
+	if (job->ret && job->connector == NULL)
+		job->ret = libddc_device_get_edid (job->device, NULL, &job->error) != NULL;
+}
+
+/**
+ * libddc_client_close_thread_cb:
+ **/
+static void
+libddc_client_close_thread_cb (gpointer data, gpointer user_data)
+{
+	LibddcClientJob *job = (LibddcClientJob *) data;
+	job->ret = libddc_device_close (job->device, &job->error);
+}
+
+/**
+ * libddc_client_run_jobs:
+ *
+ * Runs each job on a bounded worker pool and waits for all of them. The
+ * buses are independent, so their delays overlap rather than add up.
+ **/
+static gboolean
+libddc_client_run_jobs (GPtrArray *jobs, GFunc func, GError **error)
+{
+	gboolean ret = FALSE;
+	guint i;
+	GThreadPool *pool;
+
+	pool = g_thread_pool_new (func, NULL,
+				  MIN (jobs->len, LIBDDC_CLIENT_MAX_THREADS),
+				  FALSE, error);
+	if (pool == NULL)
+		goto out;
+	for (i=0; i<jobs->len; i++) {
+		ret = g_thread_pool_push (pool, g_ptr_array_index (jobs, i), error);
+		if (!ret)
+			break;
+	}
+
+	/* wait for everything already pushed */
+	g_thread_pool_free (pool, FALSE, TRUE);
+out:
+	return ret;
+}
+
+/**
+ * libddc_client_add_job:
+ **/
+static void
+libddc_client_add_job (LibddcClient *client, GPtrArray *jobs, guint bus,
+		       const gchar *connector, const gchar *edid_filename)
+{
+	guint i;
+	gchar *filename;
+	LibddcClientJob *job;
+
+	/* more than one connector can share a bus */
+	for (i=0; i<jobs->len; i++) {
+		job = g_ptr_array_index (jobs, i);
+		if (job->bus == bus)
+			return;
+	}
+
+	filename = g_strdup_printf ("/dev/i2c-%u", bus);
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
+		g_free (filename);
+		return;
+	}
+	job = g_new0 (LibddcClientJob, 1);
+	job->bus = bus;
+	job->filename = filename;
+	job->connector = g_strdup (connector);
+	job->device = libddc_device_new ();
+	libddc_device_set_verbose (job->device, client->priv->verbose);
+	if (connector != NULL)
+		libddc_device_set_connector (job->device, connector);
+	if (edid_filename != NULL)
+		libddc_device_set_edid_filename (job->device, edid_filename);
+	g_ptr_array_add (jobs, job);
+}
+
+/**
+ * libddc_client_parse_bus:
+ *
+ * Return value: the bus number from a name like "i2c-5", or G_MAXUINT
+ **/
+static guint
+libddc_client_parse_bus (const gchar *name)
+{
+	gchar *endptr = NULL;
+	guint64 bus;
+
+	if (!g_str_has_prefix (name, "i2c-"))
+		return G_MAXUINT;
+	bus = g_ascii_strtoull (name + 4, &endptr, 10);
+	if (endptr == name + 4 || *endptr != '\0' || bus >= G_MAXUINT)
+		return G_MAXUINT;
+	return bus;
+}
+
+/**
+ * libddc_client_find_drm_buses:
+ *
+ * Adds the DDC bus of each DRM connector, e.g. card0-DP-1/ddc -> i2c-5
+ **/
+static void
+libddc_client_find_drm_buses (LibddcClient *client, GPtrArray *jobs)
+{
+	const gchar *name;
+	const gchar *connector;
+	gboolean ret;
+	gchar *basename;
+	gchar *link;
+	gchar *path;
+	gchar *status = NULL;
+	guint bus;
+	GDir *dir;
+
+	dir = g_dir_open (LIBDDC_CLIENT_SYSFS_DRM, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+
+		/* only connectors have a dash, not cards or render nodes */
+		connector = strchr (name, '-');
+		if (connector == NULL)
+			continue;
+
+		/* nothing plugged in */
+		path = g_build_filename (LIBDDC_CLIENT_SYSFS_DRM, name, "status", NULL);
+		ret = g_file_get_contents (path, &status, NULL, NULL);
+		g_free (path);
+		if (ret && g_str_has_prefix (status, "disconnected")) {
+			g_free (status);
+			continue;
+		}
+		if (ret)
+			g_free (status);
+
+		path = g_build_filename (LIBDDC_CLIENT_SYSFS_DRM, name, "ddc", NULL);
+		link = g_file_read_link (path, NULL);
+		g_free (path);
+		if (link == NULL)
+			continue;
+		basename = g_path_get_basename (link);
+		bus = libddc_client_parse_bus (basename);
+		if (bus != G_MAXUINT) {
+			/* the kernel already has the EDID for this connector */
+			path = g_build_filename (LIBDDC_CLIENT_SYSFS_DRM, name, "edid", NULL);
+			libddc_client_add_job (client, jobs, bus, connector + 1, path);
+			g_free (path);
+		}
+		g_free (basename);
+		g_free (link);
+	}
+	g_dir_close (dir);
+}
+
+/**
+ * libddc_client_find_i2c_buses:
+ *
+ * Adds every adapter that is not obviously a SMBus, for drivers that do
+ * not link their connectors to a DDC bus
+ **/
+static void
+libddc_client_find_i2c_buses (LibddcClient *client, GPtrArray *jobs)
+{
+	const gchar *name;
+	gboolean ret;
+	gchar *adapter;
+	gchar *path;
+	guint bus;
+	GDir *dir;
+
+	dir = g_dir_open (LIBDDC_CLIENT_SYSFS_I2C, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		bus = libddc_client_parse_bus (name);
+		if (bus == G_MAXUINT)
+			continue;
+		path = g_build_filename (LIBDDC_CLIENT_SYSFS_I2C, name, "name", NULL);
+		ret = g_file_get_contents (path, &adapter, NULL, NULL);
+		g_free (path);
+		if (!ret)
+			continue;
+		if (!g_str_has_prefix (adapter, "SMBus"))
+			libddc_client_add_job (client, jobs, bus, NULL, NULL);
+		g_free (adapter);
+	}
+	g_dir_close (dir);
+}
+
+/**
+ * libddc_client_job_sort_cb:
+ **/
+static gint
+libddc_client_job_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const LibddcClientJob *job_a = *((LibddcClientJob **) a);
+	const LibddcClientJob *job_b = *((LibddcClientJob **) b);
+	if (job_a->bus < job_b->bus)
+		return -1;
+	if (job_a->bus > job_b->bus)
+		return 1;
+	return 0;
+}
+
 /**
  * libddc_client_ensure_coldplug:
  **/
@@ -67,9 +321,8 @@ libddc_client_ensure_coldplug (LibddcClient *client, GError **error)
 	gboolean ret = FALSE;
 	gboolean any_found = FALSE;
 	guint i;
-	gchar *filename;
-	GError *error_local = NULL;
-	LibddcDevice *device;
+	GPtrArray *jobs;
+	LibddcClientJob *job;
 
 	g_return_val_if_fail (LIBDDC_IS_CLIENT(client), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -86,29 +339,37 @@ libddc_client_ensure_coldplug (LibddcClient *client, GError **error)
 		goto out;
 	}
 
-	/* try each i2c port */
-	for (i=0; i<16; i++) {
-		filename = g_strdup_printf ("/dev/i2c-%i", i);
-		if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
-			g_free (filename);
-			break;
-		}
-		device = libddc_device_new ();
-		libddc_device_set_verbose (device, client->priv->verbose);
-		ret = libddc_device_open (device, filename, &error_local);
+	/* only probe buses that are wired to a display connector */
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) libddc_client_job_free);
+	libddc_client_find_drm_buses (client, jobs);
+	if (jobs->len == 0)
+		libddc_client_find_i2c_buses (client, jobs);
+	g_ptr_array_sort (jobs, libddc_client_job_sort_cb);
+
+	/* open them all at the same time */
+	if (jobs->len > 0) {
+		ret = libddc_client_run_jobs (jobs, libddc_client_open_thread_cb, error);
 		if (!ret) {
+			g_ptr_array_unref (jobs);
+			goto out;
+		}
+	}
+
+	/* add in bus order, whatever order they finished in */
+	for (i=0; i<jobs->len; i++) {
+		job = g_ptr_array_index (jobs, i);
+		if (!job->ret) {
 			if (client->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
-				g_warning ("failed to open %s: %s", filename, error_local->message);
-			g_clear_error (&error_local);
+				g_warning ("failed to open %s: %s", job->filename, job->error->message);
 		} else {
 			if (client->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
-				g_debug ("success, adding %s", filename);
+				g_debug ("success, adding %s (%s)", job->filename,
+					 job->connector != NULL ? job->connector : "unknown");
 			any_found = TRUE;
-			g_ptr_array_add (client->priv->devices, g_object_ref (device));
+			g_ptr_array_add (client->priv->devices, g_object_ref (job->device));
 		}
-		g_object_unref (device);
-		g_free (filename);
 	}
+	g_ptr_array_unref (jobs);
 
 	/* nothing found */
 	if (!any_found) {
@@ -131,18 +392,40 @@ libddc_client_close (LibddcClient *client, GError **error)
 {
 	guint i;
 	gboolean ret = TRUE;
-	LibddcDevice *device;
+	GPtrArray *jobs;
+	LibddcClientJob *job;
 
 	g_return_val_if_fail (LIBDDC_IS_CLIENT(client), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* iterate each device */
+	/* nothing to do */
+	if (client->priv->devices->len == 0)
+		goto out;
+
+	/* close each device at the same time */
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) libddc_client_job_free);
 	for (i=0; i<client->priv->devices->len; i++) {
-		device = g_ptr_array_index (client->priv->devices, i);
-		ret = libddc_device_close (device, error);
-		if (!ret)
-			goto out;
+		job = g_new0 (LibddcClientJob, 1);
+		job->device = g_object_ref (g_ptr_array_index (client->priv->devices, i));
+		g_ptr_array_add (jobs, job);
 	}
+	ret = libddc_client_run_jobs (jobs, libddc_client_close_thread_cb, error);
+	if (!ret) {
+		g_ptr_array_unref (jobs);
+		goto out;
+	}
+
+	/* report the first failure in bus order */
+	for (i=0; i<jobs->len; i++) {
+		job = g_ptr_array_index (jobs, i);
+		if (!job->ret) {
+			g_propagate_error (error, job->error);
+			job->error = NULL;
+			ret = FALSE;
+			break;
+		}
+	}
+	g_ptr_array_unref (jobs);
 out:
 	return ret;
 }
@@ -195,10 +478,11 @@ libddc_client_get_device_from_edid (LibddcClient *client, const gchar *edid_md5,
 	for (i=0; i<client->priv->devices->len; i++) {
 		device_tmp = g_ptr_array_index (client->priv->devices, i);
 
-		/* get the md5 of the device */
-		edid_md5_tmp = libddc_device_get_edid_md5 (device_tmp, error);
+		/* get the md5 of the device, which is read on first use so
+		 * may fail if there is nothing attached to the bus */
+		edid_md5_tmp = libddc_device_get_edid_md5 (device_tmp, NULL);
 		if (edid_md5_tmp == NULL)
-			goto out;
+			continue;
 
 		/* matches? */
 		if (g_strcmp0 (edid_md5, edid_md5_tmp) == 0) {
@@ -44,6 +44,9 @@ typedef enum {
 #define LIBDDC_CAPABILITIES_REPLY		0xe3
 #define LIBDDC_COMMAND_PRESENCE			0xf7
 #define LIBDDC_ENABLE_APPLICATION_REPORT	0xf5
+#define LIBDDC_TABLE_READ_REQUEST		0xe2
+#define LIBDDC_TABLE_READ_REPLY			0xe4
+#define LIBDDC_TABLE_WRITE			0xe7
 
 #define	LIBDDC_VCP_ID_INVALID			0x00
 
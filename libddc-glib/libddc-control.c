@@ -29,12 +29,20 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib-object.h>
 
 #include <libddc-device.h>
 #include <libddc-control.h>
 
 static void     libddc_control_finalize	(GObject     *object);
+static void     libddc_control_stream_cb	(GObject     *source,
+						 GAsyncResult *res,
+						 gpointer     user_data);
+
+/* table transfers, from MCCS */
+#define LIBDDC_CONTROL_TABLE_FRAGMENT		32	/* bytes of data in each frame */
+#define LIBDDC_CONTROL_TABLE_MAX		0xffff	/* offsets are 16 bits */
 
 #define LIBDDC_CONTROL_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_CONTROL, LibddcControlPrivate))
 
@@ -50,6 +58,22 @@ struct _LibddcControlPrivate
 	LibddcDevice		*device;
 	LibddcVerbose		 verbose;
 	GArray			*values;
+	guint16			 stream_value;
+	gboolean		 stream_pending;
+	gboolean		 stream_in_flight;
+	GList			*stream_flushes;
+	GError			*stream_error;
+	guint			 max_age;
+	gboolean		 cache_has_value;
+	gboolean		 cache_has_maximum;
+	guint16			 cache_value;
+	guint16			 cache_maximum;
+	gint64			 cache_time;
+};
+
+enum {
+	SIGNAL_CHANGED,
+	SIGNAL_LAST
 };
 
 enum {
@@ -58,9 +82,9 @@ enum {
 	PROP_LAST
 };
 
-G_DEFINE_TYPE (LibddcControl, libddc_control, G_TYPE_OBJECT)
+static guint signals [SIGNAL_LAST] = { 0 };
 
-#define LIBDDC_VCP_SET_DELAY_USECS   		50000
+G_DEFINE_TYPE (LibddcControl, libddc_control, G_TYPE_OBJECT)
 
 /**
  * libddc_control_get_description:
@@ -110,6 +134,168 @@ out:
 	return ret;
 }
 
+/**
+ * libddc_control_store_update:
+ *
+ * Records the value for other processes, if the device has a store
+ **/
+static void
+libddc_control_store_update (LibddcControl *control, guint16 value,
+			     const guint16 *maximum)
+{
+	const gchar *edid_md5;
+	guint16 maximum_old = 0;
+	LibddcStore *store;
+
+	store = libddc_device_get_store (control->priv->device);
+	if (store == NULL)
+		return;
+	edid_md5 = libddc_device_get_edid_md5 (control->priv->device, NULL);
+	if (edid_md5 == NULL)
+		return;
+
+	/* a set does not tell us the maximum, so keep the last one */
+	if (maximum == NULL) {
+		libddc_store_lookup (store, edid_md5, control->priv->id,
+				     NULL, &maximum_old, NULL);
+		maximum = &maximum_old;
+	}
+	libddc_store_update (store, edid_md5, control->priv->id, value, *maximum);
+}
+
+/**
+ * libddc_control_cache_update:
+ *
+ * Remembers a value we know the display has, and shares it if possible
+ **/
+static void
+libddc_control_cache_update (LibddcControl *control, guint16 value,
+			     const guint16 *maximum)
+{
+	LibddcControlPrivate *priv = control->priv;
+
+	priv->cache_value = value;
+	priv->cache_has_value = TRUE;
+	priv->cache_time = g_get_monotonic_time ();
+	if (maximum != NULL) {
+		priv->cache_maximum = *maximum;
+		priv->cache_has_maximum = TRUE;
+	}
+	libddc_control_store_update (control, value, maximum);
+}
+
+/**
+ * libddc_control_cache_invalidate:
+ *
+ * Forgets the value, here and for every other process using the store
+ **/
+static void
+libddc_control_cache_invalidate (LibddcControl *control)
+{
+	const guint16 maximum_unknown = 0;
+
+	/* an unknown maximum is never returned from the store */
+	control->priv->cache_has_value = FALSE;
+	libddc_control_store_update (control, 0, &maximum_unknown);
+}
+
+/**
+ * libddc_control_cache_set:
+ *
+ * Remembers a value we have written, which the display clamps to its maximum
+ **/
+static void
+libddc_control_cache_set (LibddcControl *control, guint16 value)
+{
+	/* we cannot know what the display did with it, so make everyone
+	 * read it again */
+	if (!control->priv->cache_has_maximum) {
+		libddc_control_cache_invalidate (control);
+		return;
+	}
+	libddc_control_cache_update (control, MIN (value, control->priv->cache_maximum), NULL);
+}
+
+/**
+ * libddc_control_cache_lookup:
+ *
+ * Return value: %TRUE if the cache can answer the request without the bus
+ **/
+static gboolean
+libddc_control_cache_lookup (LibddcControl *control, guint16 *value, guint16 *maximum)
+{
+	const gchar *edid_md5;
+	gint64 timestamp;
+	guint16 value_tmp;
+	guint16 maximum_tmp;
+	LibddcStore *store;
+	LibddcControlPrivate *priv = control->priv;
+
+	/* always read the display */
+	if (priv->max_age == 0)
+		return FALSE;
+
+	/* the maximum never changes, so only the value can go stale */
+	if (maximum != NULL && !priv->cache_has_maximum)
+		goto store;
+	if (value == NULL && maximum != NULL)
+		goto out;
+	if (!priv->cache_has_value)
+		goto store;
+	if (g_get_monotonic_time () - priv->cache_time > (gint64) priv->max_age * 1000)
+		goto store;
+	if (value != NULL)
+		*value = priv->cache_value;
+out:
+	if (maximum != NULL)
+		*maximum = priv->cache_maximum;
+	return TRUE;
+store:
+	/* another process may have read or written it recently */
+	store = libddc_device_get_store (priv->device);
+	if (store == NULL)
+		return FALSE;
+	edid_md5 = libddc_device_get_edid_md5 (priv->device, NULL);
+	if (edid_md5 == NULL)
+		return FALSE;
+	if (!libddc_store_lookup (store, edid_md5, priv->id,
+				  &value_tmp, &maximum_tmp, &timestamp))
+		return FALSE;
+	if (maximum_tmp == 0)
+		return FALSE;
+	if (g_get_real_time () - timestamp > (gint64) priv->max_age * 1000)
+		return FALSE;
+	priv->cache_value = value_tmp;
+	priv->cache_maximum = maximum_tmp;
+	priv->cache_has_value = TRUE;
+	priv->cache_has_maximum = TRUE;
+	priv->cache_time = g_get_monotonic_time () - (g_get_real_time () - timestamp);
+	if (value != NULL)
+		*value = value_tmp;
+	if (maximum != NULL)
+		*maximum = maximum_tmp;
+	return TRUE;
+}
+
+/**
+ * libddc_control_set_max_age:
+ * @control: a #LibddcControl
+ * @max_age: the age in milliseconds, or 0 to always read the display
+ *
+ * Sets how old a remembered value can be and still be returned by
+ * libddc_control_request_full() without %LIBDDC_CONTROL_REQUEST_FLAG_FORCE.
+ * The maximum never changes, so it is remembered for as long as the
+ * control exists, but only used when @max_age is not 0.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_control_set_max_age (LibddcControl *control, guint max_age)
+{
+	g_return_if_fail (LIBDDC_IS_CONTROL(control));
+	control->priv->max_age = max_age;
+}
+
 /**
  * libddc_control_set:
  *
@@ -129,75 +315,328 @@ libddc_control_set (LibddcControl *control, guint16 value, GError **error)
 	if (!ret)
 		goto out;
 
+	/* some displays ignore changes until enabled */
+	ret = libddc_device_ensure_startup (control->priv->device, error);
+	if (!ret)
+		goto out;
+
 	buf[0] = LIBDDC_VCP_SET;
 	buf[1] = control->priv->id;
 	buf[2] = (value >> 8);
 	buf[3] = (value & 255);
 
-	ret = libddc_device_write (control->priv->device, buf, sizeof(buf), error);
+	/* the device waits before the next command is sent */
+	ret = libddc_device_command (control->priv->device, buf, sizeof(buf), NULL, 0, NULL, error);
 	if (!ret)
 		goto out;
-
-	/* Do the delay */
-	g_usleep (LIBDDC_VCP_SET_DELAY_USECS);
+	libddc_control_cache_set (control, value);
 out:
 	return ret;
 }
 
 /**
- * libddc_control_reset:
+ * libddc_control_set_cb:
+ **/
+static void
+libddc_control_set_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *bytes;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+
+	bytes = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+	g_bytes_unref (bytes);
+	libddc_control_cache_set (g_task_get_source_object (task),
+				  GPOINTER_TO_UINT (g_task_get_task_data (task)));
+	g_task_return_boolean (task, TRUE);
+out:
+	g_object_unref (task);
+}
+
+/**
+ * libddc_control_set_async:
+ * @control: a #LibddcControl
+ * @value: the new value
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Writes the control value to the display without blocking.
+ **/
+void
+libddc_control_set_async (LibddcControl *control, guint16 value, GCancellable *cancellable,
+			  GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+	guchar buf[4];
+	GError *error = NULL;
+
+	g_return_if_fail (LIBDDC_IS_CONTROL(control));
+
+	task = g_task_new (control, cancellable, callback, user_data);
+
+	/* check this value is allowed */
+	if (!libddc_control_is_value_valid (control, value, &error)) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	g_task_set_task_data (task, GUINT_TO_POINTER (value), NULL);
+	buf[0] = LIBDDC_VCP_SET;
+	buf[1] = control->priv->id;
+	buf[2] = (value >> 8);
+	buf[3] = (value & 255);
+	libddc_device_command_async (control->priv->device, buf, sizeof(buf), 0,
+				     cancellable, libddc_control_set_cb, task);
+}
+
+/**
+ * libddc_control_set_finish:
  **/
 gboolean
-libddc_control_reset (LibddcControl *control, GError **error)
+libddc_control_set_finish (LibddcControl *control, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, control), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * libddc_control_stream_flush_return:
+ **/
+static void
+libddc_control_stream_flush_return (GTask *task, const GError *error)
+{
+	GSource *source;
+
+	/* stop watching for cancellation */
+	source = g_task_get_task_data (task);
+	if (source != NULL)
+		g_source_destroy (source);
+
+	if (error != NULL)
+		g_task_return_error (task, g_error_copy (error));
+	else
+		g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * libddc_control_stream_flush_cancelled_cb:
+ **/
+static gboolean
+libddc_control_stream_flush_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	GList *l;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+	LibddcControl *control = g_task_get_source_object (task);
+
+	/* the values still get sent, the caller just stops waiting */
+	l = g_list_find (control->priv->stream_flushes, task);
+	if (l != NULL) {
+		control->priv->stream_flushes = g_list_delete_link (control->priv->stream_flushes, l);
+		g_cancellable_set_error_if_cancelled (cancellable, &error);
+		libddc_control_stream_flush_return (task, error);
+		g_error_free (error);
+	}
+	return FALSE;
+}
+
+/**
+ * libddc_control_stream_send:
+ **/
+static void
+libddc_control_stream_send (LibddcControl *control)
+{
+	GList *l;
+	GList *flushes;
+
+	/* nothing left to send, so wake up anyone waiting */
+	if (!control->priv->stream_pending) {
+		flushes = control->priv->stream_flushes;
+		if (flushes == NULL)
+			return;
+		control->priv->stream_flushes = NULL;
+		for (l = flushes; l != NULL; l = l->next)
+			libddc_control_stream_flush_return (G_TASK (l->data), control->priv->stream_error);
+		g_list_free (flushes);
+		g_clear_error (&control->priv->stream_error);
+		return;
+	}
+
+	/* only the latest value is sent, and only once the last frame is out */
+	control->priv->stream_pending = FALSE;
+	control->priv->stream_in_flight = TRUE;
+	libddc_control_set_async (control, control->priv->stream_value, NULL,
+				  libddc_control_stream_cb, NULL);
+}
+
+/**
+ * libddc_control_stream_cb:
+ **/
+static void
+libddc_control_stream_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+	LibddcControl *control = LIBDDC_CONTROL (source);
+
+	/* a newer value getting through makes an older failure moot */
+	control->priv->stream_in_flight = FALSE;
+	ret = libddc_control_set_finish (control, res, &error);
+	g_clear_error (&control->priv->stream_error);
+	if (!ret)
+		control->priv->stream_error = error;
+	libddc_control_stream_send (control);
+}
+
+/**
+ * libddc_control_stream_push:
+ * @control: a #LibddcControl
+ * @value: the new value
+ * @error: a #GError, or %NULL
+ *
+ * Queues a new value for the control without blocking, for instance
+ * while a slider is being dragged. Only the latest value is kept, and
+ * values pushed while a frame is being sent replace each other, so the
+ * display is never more than one command behind the caller.
+ *
+ * Return value: %FALSE if the value is not allowed for this control
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_control_stream_push (LibddcControl *control, guint16 value, GError **error)
 {
 	gboolean ret;
-	guchar buf[2];
 
 	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	buf[0] = LIBDDC_VCP_RESET;
-	buf[1] = control->priv->id;
-
-	ret = libddc_device_write (control->priv->device, buf, sizeof(buf), error);
+	/* check this value is allowed */
+	ret = libddc_control_is_value_valid (control, value, error);
 	if (!ret)
 		goto out;
 
-	/* Do the delay */
-	g_usleep (LIBDDC_VCP_SET_DELAY_USECS);
+	control->priv->stream_value = value;
+	control->priv->stream_pending = TRUE;
+	if (!control->priv->stream_in_flight)
+		libddc_control_stream_send (control);
 out:
 	return ret;
 }
 
 /**
- * libddc_control_request:
+ * libddc_control_stream_flush_async:
+ * @control: a #LibddcControl
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Waits until the last value pushed with libddc_control_stream_push()
+ * has been sent to the display. If the display did not accept the last
+ * value sent, and nothing newer got through since, the error is returned
+ * from libddc_control_stream_flush_finish().
+ *
+ * Cancelling only stops the wait; the latest value is still sent.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_control_stream_flush_async (LibddcControl *control, GCancellable *cancellable,
+				   GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+	GSource *source;
+
+	g_return_if_fail (LIBDDC_IS_CONTROL(control));
+
+	task = g_task_new (control, cancellable, callback, user_data);
+	if (g_task_return_error_if_cancelled (task)) {
+		g_object_unref (task);
+		return;
+	}
+	if (!control->priv->stream_pending && !control->priv->stream_in_flight) {
+		libddc_control_stream_flush_return (task, control->priv->stream_error);
+		g_clear_error (&control->priv->stream_error);
+		return;
+	}
+
+	/* the source holds a ref on the task until it is destroyed */
+	if (cancellable != NULL) {
+		source = g_cancellable_source_new (cancellable);
+		g_task_set_task_data (task, source, (GDestroyNotify) g_source_unref);
+		g_task_attach_source (task, source, (GSourceFunc) libddc_control_stream_flush_cancelled_cb);
+	}
+	control->priv->stream_flushes = g_list_append (control->priv->stream_flushes, task);
+}
+
+/**
+ * libddc_control_stream_flush_finish:
  **/
 gboolean
-libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum, GError **error)
+libddc_control_stream_flush_finish (LibddcControl *control, GAsyncResult *res, GError **error)
 {
-	gboolean ret = FALSE;
-	guchar buf[8];
-	gsize len;
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, control), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * libddc_control_reset:
+ **/
+gboolean
+libddc_control_reset (LibddcControl *control, GError **error)
+{
+	gboolean ret;
+	guchar buf[2];
 
 	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* request data */
-	buf[0] = LIBDDC_VCP_REQUEST;
-	buf[1] = control->priv->id;
-	if (!libddc_device_write (control->priv->device, buf, 2, error))
+	/* some displays ignore changes until enabled */
+	ret = libddc_device_ensure_startup (control->priv->device, error);
+	if (!ret)
 		goto out;
 
-	/* get data */
-	ret = libddc_device_read (control->priv->device, buf, 8, &len, error);
+	buf[0] = LIBDDC_VCP_RESET;
+	buf[1] = control->priv->id;
+
+	/* the device waits before the next command is sent */
+	ret = libddc_device_command (control->priv->device, buf, sizeof(buf), NULL, 0, NULL, error);
 	if (!ret)
 		goto out;
 
+	/* only the display knows the factory default */
+	libddc_control_cache_invalidate (control);
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_parse_reply:
+ *
+ * Check and decode a VCP reply
+ **/
+static gboolean
+libddc_control_parse_reply (LibddcControl *control, const guchar *buf, gsize len, guint16 *value, guint16 *maximum, GError **error)
+{
+	gboolean ret = FALSE;
+
 	/* check we got enough data */
-	if (len != sizeof(buf)) {
+	if (len != 8) {
 		g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
 			     "Failed to parse control 0x%02x as incorrect length", control->priv->id);
-		ret = FALSE;
 		goto out;
 	}
 
@@ -205,7 +644,6 @@ libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum
 	if (buf[0] != LIBDDC_VCP_REPLY) {
 		g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
 			     "Failed to parse control 0x%02x as incorrect command returned", control->priv->id);
-		ret = FALSE;
 		goto out;
 	}
 
@@ -213,7 +651,6 @@ libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum
 	if (buf[1] != 0) {
 		g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
 			     "Failed to parse control 0x%02x as unsupported", control->priv->id);
-		ret = FALSE;
 		goto out;
 	}
 
@@ -221,7 +658,6 @@ libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum
 	if (buf[2] != control->priv->id) {
 		g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
 			     "Failed to parse control 0x%02x as incorrect id returned", control->priv->id);
-		ret = FALSE;
 		goto out;
 	}
 
@@ -229,6 +665,356 @@ libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum
 		*value = buf[6] * 256 + buf[7];
 	if (maximum != NULL)
 		*maximum = buf[4] * 256 + buf[5];
+	ret = TRUE;
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_request:
+ **/
+gboolean
+libddc_control_request (LibddcControl *control, guint16 *value, guint16 *maximum, GError **error)
+{
+	return libddc_control_request_full (control, LIBDDC_CONTROL_REQUEST_FLAG_NONE,
+					    value, maximum, error);
+}
+
+/**
+ * libddc_control_request_full:
+ * @control: a #LibddcControl
+ * @flags: a #LibddcControlRequestFlags, e.g. %LIBDDC_CONTROL_REQUEST_FLAG_FORCE
+ * @value: the current value, or %NULL
+ * @maximum: the maximum value, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Reads the control, using a remembered value if it is newer than the
+ * maximum age set with libddc_control_set_max_age().
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_control_request_full (LibddcControl *control, LibddcControlRequestFlags flags,
+			     guint16 *value, guint16 *maximum, GError **error)
+{
+	gboolean ret = FALSE;
+	guchar buf[8];
+	gsize len;
+	guint16 value_tmp;
+	guint16 maximum_tmp;
+
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* avoid the round trip if we can */
+	if ((flags & LIBDDC_CONTROL_REQUEST_FLAG_FORCE) == 0 &&
+	    libddc_control_cache_lookup (control, value, maximum)) {
+		ret = TRUE;
+		goto out;
+	}
+
+	/* some displays ignore requests until enabled */
+	if (!libddc_device_ensure_startup (control->priv->device, error))
+		goto out;
+
+	/* request data, retrying if the display allows */
+	buf[0] = LIBDDC_VCP_REQUEST;
+	buf[1] = control->priv->id;
+	ret = libddc_device_command (control->priv->device, buf, 2, buf, 8, &len, error);
+	if (!ret)
+		goto out;
+
+	/* decode */
+	ret = libddc_control_parse_reply (control, buf, len, &value_tmp, &maximum_tmp, error);
+	if (!ret)
+		goto out;
+	libddc_control_cache_update (control, value_tmp, &maximum_tmp);
+	if (value != NULL)
+		*value = value_tmp;
+	if (maximum != NULL)
+		*maximum = maximum_tmp;
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_request_cb:
+ **/
+static void
+libddc_control_request_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gsize len;
+	const guchar *buf;
+	guint16 *result;
+	GBytes *bytes;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+	LibddcControl *control = g_task_get_source_object (task);
+
+	bytes = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	/* decode */
+	result = g_new0 (guint16, 2);
+	buf = g_bytes_get_data (bytes, &len);
+	if (!libddc_control_parse_reply (control, buf, len, &result[0], &result[1], &error)) {
+		g_free (result);
+		g_task_return_error (task, error);
+	} else {
+		libddc_control_cache_update (control, result[0], &result[1]);
+		g_task_return_pointer (task, result, g_free);
+	}
+	g_bytes_unref (bytes);
+out:
+	g_object_unref (task);
+}
+
+/**
+ * libddc_control_request_async:
+ * @control: a #LibddcControl
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Reads the control value from the display without blocking.
+ **/
+void
+libddc_control_request_async (LibddcControl *control, GCancellable *cancellable,
+			      GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+	guchar buf[2];
+
+	g_return_if_fail (LIBDDC_IS_CONTROL(control));
+
+	task = g_task_new (control, cancellable, callback, user_data);
+	buf[0] = LIBDDC_VCP_REQUEST;
+	buf[1] = control->priv->id;
+	libddc_device_command_async (control->priv->device, buf, sizeof(buf), 8,
+				     cancellable, libddc_control_request_cb, task);
+}
+
+/**
+ * libddc_control_request_finish:
+ * @control: a #LibddcControl
+ * @res: the #GAsyncResult
+ * @value: the current value, or %NULL
+ * @maximum: the maximum value, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+libddc_control_request_finish (LibddcControl *control, GAsyncResult *res,
+			       guint16 *value, guint16 *maximum, GError **error)
+{
+	guint16 *result;
+
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, control), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	result = g_task_propagate_pointer (G_TASK (res), error);
+	if (result == NULL)
+		return FALSE;
+	if (value != NULL)
+		*value = result[0];
+	if (maximum != NULL)
+		*maximum = result[1];
+	g_free (result);
+	return TRUE;
+}
+
+/**
+ * libddc_control_table_read:
+ * @control: a #LibddcControl
+ * @data: a caller-owned buffer for the table
+ * @data_length: the size of @data
+ * @received_length: (out): the size of the table, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Reads a table control such as a LUT. The table is requested in
+ * fragments at increasing offsets until the display sends an empty one,
+ * only waiting as long as the display needs between frames. A lost or
+ * corrupted fragment is requested again, as allowed by the retry policy
+ * of the device.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_control_table_read (LibddcControl *control, guchar *data, gsize data_length,
+			   gsize *received_length, GError **error)
+{
+	gboolean ret = FALSE;
+	guchar buf[LIBDDC_CONTROL_TABLE_FRAGMENT + 3];
+	guchar request[4];
+	gsize len = 0;
+	gsize offset = 0;
+
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* some displays ignore requests until enabled */
+	if (!libddc_device_ensure_startup (control->priv->device, error))
+		goto out;
+
+	do {
+		request[0] = LIBDDC_TABLE_READ_REQUEST;
+		request[1] = control->priv->id;
+		request[2] = offset >> 8;
+		request[3] = offset & 255;
+		ret = libddc_device_command (control->priv->device, request, sizeof(request),
+					     buf, sizeof(buf), &len, error);
+		if (!ret)
+			goto out;
+		if (len < 3 || buf[0] != LIBDDC_TABLE_READ_REPLY ||
+		    buf[1] * 256 + buf[2] != offset) {
+			g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
+				     "Failed to read table 0x%02x at offset 0x%04x as invalid reply",
+				     control->priv->id, (guint) offset);
+			ret = FALSE;
+			goto out;
+		}
+
+		/* add to results */
+		if (offset + len - 3 > MIN (data_length, LIBDDC_CONTROL_TABLE_MAX)) {
+			g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
+				     "Failed to read table 0x%02x as larger than %" G_GSIZE_FORMAT " bytes",
+				     control->priv->id, data_length);
+			ret = FALSE;
+			goto out;
+		}
+		memcpy (data + offset, buf + 3, len - 3);
+		offset += len - 3;
+	} while (len != 3);
+
+	if (received_length != NULL)
+		*received_length = offset;
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_table_write_fragment:
+ **/
+static gboolean
+libddc_control_table_write_fragment (LibddcControl *control, gsize offset,
+				     const guchar *data, gsize length, GError **error)
+{
+	gboolean ret = FALSE;
+	guchar buf[LIBDDC_CONTROL_TABLE_FRAGMENT + 4];
+
+	/* offsets are only 16 bits */
+	if (offset + length > LIBDDC_CONTROL_TABLE_MAX) {
+		g_set_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED,
+			     "Failed to write table 0x%02x as larger than %u bytes",
+			     control->priv->id, LIBDDC_CONTROL_TABLE_MAX);
+		goto out;
+	}
+
+	buf[0] = LIBDDC_TABLE_WRITE;
+	buf[1] = control->priv->id;
+	buf[2] = offset >> 8;
+	buf[3] = offset & 255;
+	memcpy (buf + 4, data, length);
+
+	/* the device waits before the next fragment is sent */
+	ret = libddc_device_command (control->priv->device, buf, length + 4, NULL, 0, NULL, error);
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_table_write:
+ * @control: a #LibddcControl
+ * @data: the table data
+ * @length: the size of @data
+ * @error: a #GError, or %NULL
+ *
+ * Writes a table control such as a LUT, in fragments at increasing
+ * offsets, only waiting as long as the display needs between frames.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_control_table_write (LibddcControl *control, const guchar *data, gsize length, GError **error)
+{
+	gboolean ret;
+	gsize offset;
+
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (data != NULL || length == 0, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* some displays ignore changes until enabled */
+	ret = libddc_device_ensure_startup (control->priv->device, error);
+	if (!ret)
+		goto out;
+
+	for (offset = 0; offset < length; offset += LIBDDC_CONTROL_TABLE_FRAGMENT) {
+		ret = libddc_control_table_write_fragment (control, offset, data + offset,
+							   MIN (length - offset, LIBDDC_CONTROL_TABLE_FRAGMENT),
+							   error);
+		if (!ret)
+			goto out;
+	}
+out:
+	return ret;
+}
+
+/**
+ * libddc_control_table_write_stream:
+ * @control: a #LibddcControl
+ * @stream: a #GInputStream with the table data
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Writes a table control from a stream until it ends. The next fragment
+ * is read from @stream while the display is still busy with the last.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_control_table_write_stream (LibddcControl *control, GInputStream *stream,
+				   GCancellable *cancellable, GError **error)
+{
+	gboolean ret;
+	guchar buf[LIBDDC_CONTROL_TABLE_FRAGMENT];
+	gsize len;
+	gsize offset = 0;
+
+	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
+	g_return_val_if_fail (G_IS_INPUT_STREAM(stream), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* some displays ignore changes until enabled */
+	ret = libddc_device_ensure_startup (control->priv->device, error);
+	if (!ret)
+		goto out;
+
+	do {
+		ret = g_input_stream_read_all (stream, buf, sizeof(buf), &len, cancellable, error);
+		if (!ret)
+			goto out;
+		if (len == 0)
+			break;
+		ret = libddc_control_table_write_fragment (control, offset, buf, len, error);
+		if (!ret)
+			goto out;
+		offset += len;
+	} while (len == sizeof(buf));
 out:
 	return ret;
 }
@@ -244,8 +1030,12 @@ libddc_control_run (LibddcControl *control, GError **error)
 	g_return_val_if_fail (LIBDDC_IS_CONTROL(control), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* the startup command is itself run, so this cannot recurse */
+	if (!libddc_device_ensure_startup (control->priv->device, error))
+		return FALSE;
+
 	buf[0] = control->priv->id;
-	return libddc_device_write (control->priv->device, buf, sizeof(buf), error);
+	return libddc_device_command (control->priv->device, buf, sizeof(buf), NULL, 0, NULL, error);
 }
 
 /**
@@ -269,10 +1059,12 @@ libddc_control_parse (LibddcControl *control, guchar id, const gchar *values)
 	if (values == NULL)
 		goto out;
 
-	/* tokenize */
+	/* tokenize, the values are hex like the control IDs */
 	split = g_strsplit (values, " ", -1);
 	for (i=0; split[i] != NULL; i++) {
-		value = atoi (split[i]);
+		if (split[i][0] == '\0')
+			continue;
+		value = g_ascii_strtoull (split[i], NULL, 16);
 		if (control->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
 			g_debug ("add value %i to control 0x%02x", value, id);
 		g_array_append_val (control->priv->values, value);
@@ -396,6 +1188,23 @@ libddc_control_class_init (LibddcControlClass *klass)
 				      G_PARAM_READABLE);
 	g_object_class_install_property (object_class, PROP_SUPPORTED, pspec);
 
+	/**
+	 * LibddcControl::changed:
+	 * @control: the #LibddcControl
+	 * @value: the new value
+	 *
+	 * The ::changed signal is emitted when the value was changed on the
+	 * display itself, for instance using the buttons on the front panel.
+	 *
+	 * Since: 0.0.1
+	 **/
+	signals [SIGNAL_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (LibddcControlClass, changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+
 	g_type_class_add_private (klass, sizeof (LibddcControlPrivate));
 }
 
@@ -422,6 +1231,8 @@ libddc_control_finalize (GObject *object)
 	g_return_if_fail (LIBDDC_IS_CONTROL(control));
 
 	g_array_free (priv->values, TRUE);
+	if (priv->stream_error != NULL)
+		g_error_free (priv->stream_error);
 	if (priv->device != NULL)
 		g_object_unref (priv->device);
 
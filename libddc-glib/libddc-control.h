@@ -55,6 +55,19 @@ typedef enum
 	LIBDDC_CONTROL_ERROR_FAILED
 } LibddcControlError;
 
+/**
+ * LibddcControlRequestFlags:
+ * @LIBDDC_CONTROL_REQUEST_FLAG_NONE: use a remembered value if fresh enough
+ * @LIBDDC_CONTROL_REQUEST_FLAG_FORCE: always read the value from the display
+ *
+ * Flags used when requesting a control value
+ */
+typedef enum
+{
+	LIBDDC_CONTROL_REQUEST_FLAG_NONE	= 0,
+	LIBDDC_CONTROL_REQUEST_FLAG_FORCE	= 1 << 0
+} LibddcControlRequestFlags;
+
 typedef struct _LibddcControlPrivate		LibddcControlPrivate;
 typedef struct _LibddcControl			LibddcControl;
 typedef struct _LibddcControlClass		LibddcControlClass;
@@ -68,8 +81,10 @@ struct _LibddcControl
 struct _LibddcControlClass
 {
 	GObjectClass	parent_class;
+	/* signals */
+	void		(* changed)		(LibddcControl	*control,
+						 guint		 value);
 	/* padding for future expansion */
-	void (*_libddc_reserved1) (void);
 	void (*_libddc_reserved2) (void);
 	void (*_libddc_reserved3) (void);
 	void (*_libddc_reserved4) (void);
@@ -82,7 +97,9 @@ typedef struct {
 } LibddcControlCap;
 
 /* control numbers */
+#define LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE		0x02
 #define LIBDDC_CONTROL_ID_BRIGHTNESS			0x10
+#define LIBDDC_CONTROL_ID_ACTIVE_CONTROL		0x52
 
 GQuark		 libddc_control_error_quark		(void);
 GType		 libddc_control_get_type		(void);
@@ -101,9 +118,56 @@ gboolean	 libddc_control_request			(LibddcControl	*control,
 							 guint16	*value,
 							 guint16	*maximum,
 							 GError		**error);
+gboolean	 libddc_control_request_full		(LibddcControl	*control,
+							 LibddcControlRequestFlags flags,
+							 guint16	*value,
+							 guint16	*maximum,
+							 GError		**error);
+void		 libddc_control_set_max_age		(LibddcControl	*control,
+							 guint		 max_age);
+void		 libddc_control_request_async		(LibddcControl	*control,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 libddc_control_request_finish		(LibddcControl	*control,
+							 GAsyncResult	*res,
+							 guint16	*value,
+							 guint16	*maximum,
+							 GError		**error);
 gboolean	 libddc_control_set			(LibddcControl	*control,
 							 guint16	 value,
 							 GError		**error);
+void		 libddc_control_set_async		(LibddcControl	*control,
+							 guint16	 value,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 libddc_control_set_finish		(LibddcControl	*control,
+							 GAsyncResult	*res,
+							 GError		**error);
+gboolean	 libddc_control_stream_push		(LibddcControl	*control,
+							 guint16	 value,
+							 GError		**error);
+void		 libddc_control_stream_flush_async	(LibddcControl	*control,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 libddc_control_stream_flush_finish	(LibddcControl	*control,
+							 GAsyncResult	*res,
+							 GError		**error);
+gboolean	 libddc_control_table_read		(LibddcControl	*control,
+							 guchar		*data,
+							 gsize		 data_length,
+							 gsize		*received_length,
+							 GError		**error);
+gboolean	 libddc_control_table_write		(LibddcControl	*control,
+							 const guchar	*data,
+							 gsize		 length,
+							 GError		**error);
+gboolean	 libddc_control_table_write_stream	(LibddcControl	*control,
+							 GInputStream	*stream,
+							 GCancellable	*cancellable,
+							 GError		**error);
 gboolean	 libddc_control_reset			(LibddcControl	*control,
 							 GError		**error);
 guchar		 libddc_control_get_id			(LibddcControl	*control);
@@ -30,11 +30,13 @@
 
 #include <glib-object.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/file.h>
 #include <linux/types.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
@@ -45,6 +47,7 @@
 #include <libddc-control.h>
 
 static void     libddc_device_finalize	(GObject     *object);
+static void     libddc_device_load_timings	(LibddcDevice *device);
 
 #define LIBDDC_DEVICE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_DEVICE, LibddcDevicePrivate))
 
@@ -53,8 +56,40 @@ static void     libddc_device_finalize	(GObject     *object);
 #define LIBDDC_READ_DELAY_SECS   		0.04f
 #define LIBDDC_WRITE_DELAY_SECS   		0.05f
 
+/* EDID */
+#define LIBDDC_EDID_BLOCK_SIZE			128
+#define LIBDDC_EDID_SEGMENT_ADDR		0x30	/* E-DDC segment pointer */
+#define LIBDDC_EDID_MAX_SEGMENTS		8	/* two blocks in each */
+
+/* delay calibration */
+#define LIBDDC_CALIBRATE_PROBES			3	/* probes that have to pass at each step */
+#define LIBDDC_CALIBRATE_STEP			0.75f	/* factor to shrink the delays by */
+#define LIBDDC_CALIBRATE_MIN_FACTOR		0.1f	/* never go faster than this */
+#define LIBDDC_CALIBRATE_MARGIN			1.5f	/* applied to the fastest passing step */
+
 #define LIBDDC_SAVE_CURRENT_SETTINGS		0x0c
-#define LIBDDC_SAVE_DELAY_USECS   		200000
+
+/* capabilities fetch */
+#define LIBDDC_CAPS_FRAGMENT_MAX		(LIBDDC_MAX_MESSAGE_BYTES - 3)
+#define LIBDDC_CAPS_RETRIES			5	/* failures allowed for each fragment */
+#define LIBDDC_CAPS_BACKOFF_SECS		0.05f	/* doubled after each failure */
+#define LIBDDC_CAPS_BACKOFF_MAX_SECS		0.8f
+
+/* the default retry policy for each kind of error */
+#define LIBDDC_RETRY_NULL_MESSAGE		3	/* the display was not ready yet */
+#define LIBDDC_RETRY_NULL_MESSAGE_SECS		0.02f
+#define LIBDDC_RETRY_BUSY			2
+#define LIBDDC_RETRY_BUSY_SECS			0.05f
+#define LIBDDC_RETRY_CHECKSUM			2	/* noise on the bus, so just ask again */
+#define LIBDDC_RETRY_TOO_LONG			1
+
+/* the time the display needs after each kind of command, from MCCS */
+#define LIBDDC_VCP_REQUEST_DELAY_SECS		0.04f
+#define LIBDDC_VCP_SET_DELAY_SECS		0.05f
+#define LIBDDC_CAPABILITIES_DELAY_SECS		0.05f
+#define LIBDDC_TABLE_READ_DELAY_SECS		0.05f
+#define LIBDDC_TABLE_WRITE_DELAY_SECS		0.05f
+#define LIBDDC_SAVE_DELAY_SECS			0.2f
 
 /* magic numbers */
 #define LIBDDC_MAGIC_BYTE1			0x51	/* host address */
@@ -73,15 +108,39 @@ struct _LibddcDevicePrivate
 	LibddcDeviceKind	 kind;
 	gchar			*model;
 	gchar			*pnpid;
+	gchar			*connector;
+	gchar			*edid_filename;
 	guint8			*edid_data;
 	gsize			 edid_length;
+	guint			 edid_extensions;
 	gchar			*edid_md5;
 	GPtrArray		*controls;
 	gboolean		 has_controls;
 	gboolean		 has_edid;
-	gdouble			 required_wait;
-	GTimer			*timer;
+	gboolean		 has_startup;
+	gboolean		 use_cache;
+	guint			 caps_fragments;
+	guint			 caps_bytes;
+	guint			 caps_retries;
+	LibddcStore		*store;
+	gint64			 busy_until;
+	LibddcDeviceError	 bus_error;
+	guint			 retry_max[LIBDDC_DEVICE_ERROR_LAST];
+	gdouble			 retry_delay[LIBDDC_DEVICE_ERROR_LAST];
+	guint			 error_count[LIBDDC_DEVICE_ERROR_LAST];
+	guint			 retry_count[LIBDDC_DEVICE_ERROR_LAST];
+	LibddcDeviceStats	 stats[LIBDDC_DEVICE_STATS_KIND_LAST];
+	LibddcDeviceStatsKind	 stats_kind;
+	GPtrArray		*caps_waiters;
+	GPtrArray		*startup_waiters;
+	GQueue			*commands;
+	gboolean		 manual_dispatch;
+	gdouble			 read_delay;
+	gdouble			 write_delay;
 	LibddcVerbose		 verbose;
+	const LibddcDeviceTransport *transport;
+	gpointer		 transport_data;
+	GDestroyNotify		 transport_destroy;
 };
 
 enum {
@@ -92,6 +151,45 @@ enum {
 
 G_DEFINE_TYPE (LibddcDevice, libddc_device, G_TYPE_OBJECT)
 
+/* the upper limit of each histogram bucket in microseconds */
+static const guint64 libddc_device_stats_buckets[LIBDDC_DEVICE_STATS_BUCKETS] = {
+	1000, 2000, 5000, 10000, 20000, 50000, 100000, G_MAXUINT64 };
+
+/**
+ * libddc_device_stats_bucket:
+ **/
+static guint
+libddc_device_stats_bucket (guint64 usecs)
+{
+	guint i;
+	for (i=0; usecs >= libddc_device_stats_buckets[i]; i++);
+	return i;
+}
+
+/**
+ * libddc_device_stats_add_sleep:
+ **/
+static void
+libddc_device_stats_add_sleep (LibddcDevice *device, gint64 usecs)
+{
+	LibddcDeviceStats *stats = &device->priv->stats[device->priv->stats_kind];
+	stats->sleep_time += usecs;
+	stats->sleep_histogram[libddc_device_stats_bucket (usecs)]++;
+}
+
+/**
+ * libddc_device_stats_add_bus:
+ **/
+static void
+libddc_device_stats_add_bus (LibddcDevice *device, gint64 usecs, gsize written, gsize read)
+{
+	LibddcDeviceStats *stats = &device->priv->stats[device->priv->stats_kind];
+	stats->bus_time += usecs;
+	stats->bus_histogram[libddc_device_stats_bucket (usecs)]++;
+	stats->bytes_written += written;
+	stats->bytes_read += read;
+}
+
 /**
  * libddc_device_print_hex_data:
  **/
@@ -114,26 +212,101 @@ libddc_device_print_hex_data (const gchar *text, const guchar *data, gsize lengt
 
 /**
  * libddc_device_set_required_wait:
+ *
+ * Marks the bus as busy until @delay seconds from now
  **/
 static void
 libddc_device_set_required_wait (LibddcDevice *device, gdouble delay)
 {
-	device->priv->required_wait = delay;
+	device->priv->busy_until = g_get_monotonic_time () + delay * G_USEC_PER_SEC;
+}
+
+/**
+ * libddc_device_backoff:
+ *
+ * Gives a flaky display longer to recover after each failure, with some
+ * jitter so several buses do not retry in lockstep
+ **/
+static void
+libddc_device_backoff (LibddcDevice *device, guint failures)
+{
+	gdouble delay;
+	gint64 busy_until;
+
+	delay = LIBDDC_CAPS_BACKOFF_SECS * (1 << MIN (failures, 8));
+	delay = MIN (delay, LIBDDC_CAPS_BACKOFF_MAX_SECS);
+	delay += g_random_double_range (0.0, delay / 2);
+	busy_until = g_get_monotonic_time () + delay * G_USEC_PER_SEC;
+	device->priv->busy_until = MAX (device->priv->busy_until, busy_until);
+	device->priv->caps_retries++;
+}
+
+/**
+ * libddc_device_i2c_open:
+ **/
+static gboolean
+libddc_device_i2c_open (LibddcDevice *device, const gchar *filename, gpointer user_data, GError **error)
+{
+	gboolean ret;
+
+	/* ensure we have the module loaded */
+	ret = g_file_test ("/sys/module/i2c_dev/srcversion", G_FILE_TEST_EXISTS);
+	if (!ret) {
+		g_set_error_literal (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "unable to use I2C, you need to 'modprobe i2c-dev'");
+		goto out;
+	}
+
+	/* open file */
+	device->priv->fd = open (filename, O_RDWR);
+	if (device->priv->fd < 0) {
+		ret = FALSE;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to open: %i", device->priv->fd);
+		goto out;
+	}
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_i2c_set_error:
+ *
+ * The kernel uses ENXIO and EREMOTEIO when nothing acknowledged the
+ * transfer. A lost arbitration or a timeout may go away by itself, so
+ * those are treated like a busy display, and anything else is a failure.
+ **/
+static void
+libddc_device_i2c_set_error (gint errsv, LibddcDeviceError *kind, GError **error)
+{
+	switch (errsv) {
+	case ENXIO:
+	case EREMOTEIO:
+		*kind = LIBDDC_DEVICE_ERROR_NACK;
+		break;
+	case EAGAIN:
+	case EBUSY:
+	case ETIMEDOUT:
+		*kind = LIBDDC_DEVICE_ERROR_BUSY;
+		break;
+	default:
+		*kind = LIBDDC_DEVICE_ERROR_FAILED;
+		break;
+	}
+	g_set_error (error, LIBDDC_DEVICE_ERROR, *kind,
+		     "ioctl failed: %s", g_strerror (errsv));
 }
 
 /**
  * libddc_device_i2c_write:
  **/
 static gboolean
-libddc_device_i2c_write (LibddcDevice *device, guint addr, const guchar *data, gsize length, GError **error)
+libddc_device_i2c_write (LibddcDevice *device, guint addr, const guchar *data, gsize length, LibddcDeviceError *kind, gpointer user_data, GError **error)
 {
 	gint i;
 	struct i2c_rdwr_ioctl_data msg_rdwr;
 	struct i2c_msg i2cmsg;
 
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
 	/* done, prepare message */
 	msg_rdwr.msgs = &i2cmsg;
 	msg_rdwr.nmsgs = 1;
@@ -145,14 +318,10 @@ libddc_device_i2c_write (LibddcDevice *device, guint addr, const guchar *data, g
 
 	/* hit hardware */
 	i = ioctl (device->priv->fd, I2C_RDWR, &msg_rdwr);
-	if (i < 0 ) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "ioctl returned %d", i);
+	if (i < 0) {
+		libddc_device_i2c_set_error (errno, kind, error);
 		return FALSE;
 	}
-
-	if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-		libddc_device_print_hex_data ("Send", data, length);
 	return TRUE;
 }
 
@@ -160,15 +329,12 @@ libddc_device_i2c_write (LibddcDevice *device, guint addr, const guchar *data, g
  * libddc_device_i2c_read:
  **/
 static gboolean
-libddc_device_i2c_read (LibddcDevice *device, guint addr, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
+libddc_device_i2c_read (LibddcDevice *device, guint addr, guchar *data, gsize data_length, gsize *recieved_length, LibddcDeviceError *kind, gpointer user_data, GError **error)
 {
 	struct i2c_rdwr_ioctl_data msg_rdwr;
 	struct i2c_msg i2cmsg;
 	gint i;
 
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
 	msg_rdwr.msgs = &i2cmsg;
 	msg_rdwr.nmsgs = 1;
 
@@ -180,19 +346,179 @@ libddc_device_i2c_read (LibddcDevice *device, guint addr, guchar *data, gsize da
 	/* hit hardware */
 	i = ioctl (device->priv->fd, I2C_RDWR, &msg_rdwr);
 	if (i < 0) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "ioctl returned %d", i);
+		libddc_device_i2c_set_error (errno, kind, error);
 		return FALSE;
 	}
 
 	if (recieved_length != NULL)
 		*recieved_length = i2cmsg.len;
+	return TRUE;
+}
+
+/**
+ * libddc_device_i2c_transfer:
+ **/
+static gboolean
+libddc_device_i2c_transfer (LibddcDevice *device, LibddcDeviceMessage *msgs, guint n_msgs, LibddcDeviceError *kind, gpointer user_data, GError **error)
+{
+	guint j;
+	gint i;
+	struct i2c_rdwr_ioctl_data msg_rdwr;
+	struct i2c_msg i2cmsgs[I2C_RDWR_IOCTL_MAX_MSGS];
 
-	if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-		libddc_device_print_hex_data ("Recv", data, i2cmsg.len);
+	if (n_msgs > I2C_RDWR_IOCTL_MAX_MSGS) {
+		*kind = LIBDDC_DEVICE_ERROR_FAILED;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "too many messages in one transaction: %i", n_msgs);
+		return FALSE;
+	}
+
+	/* prepare all the messages */
+	for (j=0; j<n_msgs; j++) {
+		i2cmsgs[j].addr  = msgs[j].addr;
+		i2cmsgs[j].flags = msgs[j].read ? I2C_M_RD : 0;
+		i2cmsgs[j].len   = msgs[j].length;
+		i2cmsgs[j].buf   = msgs[j].data;
+	}
+	msg_rdwr.msgs = i2cmsgs;
+	msg_rdwr.nmsgs = n_msgs;
+
+	/* hit hardware */
+	i = ioctl (device->priv->fd, I2C_RDWR, &msg_rdwr);
+	if (i < 0) {
+		libddc_device_i2c_set_error (errno, kind, error);
+		return FALSE;
+	}
 	return TRUE;
 }
 
+/**
+ * libddc_device_i2c_close:
+ **/
+static void
+libddc_device_i2c_close (LibddcDevice *device, gpointer user_data)
+{
+	if (device->priv->fd < 0)
+		return;
+	close (device->priv->fd);
+	device->priv->fd = -1;
+}
+
+/* the default transport, using the kernel i2c-dev interface */
+static const LibddcDeviceTransport libddc_device_i2c_transport = {
+	libddc_device_i2c_open,
+	libddc_device_i2c_read,
+	libddc_device_i2c_write,
+	libddc_device_i2c_close,
+	libddc_device_i2c_transfer
+};
+
+/**
+ * libddc_device_bus_write:
+ **/
+static gboolean
+libddc_device_bus_write (LibddcDevice *device, guint addr, const guchar *data, gsize length, GError **error)
+{
+	gboolean ret;
+	gint64 start;
+	LibddcDevicePrivate *priv = device->priv;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	start = g_get_monotonic_time ();
+	priv->bus_error = LIBDDC_DEVICE_ERROR_NACK;
+	ret = priv->transport->write (device, addr, data, length, &priv->bus_error, priv->transport_data, error);
+	libddc_device_stats_add_bus (device, g_get_monotonic_time () - start, ret ? length : 0, 0);
+	if (!ret)
+		goto out;
+
+	if (priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+		libddc_device_print_hex_data ("Send", data, length);
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_bus_read:
+ **/
+static gboolean
+libddc_device_bus_read (LibddcDevice *device, guint addr, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
+{
+	gboolean ret;
+	gint64 start;
+	gsize len = data_length;
+	LibddcDevicePrivate *priv = device->priv;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	start = g_get_monotonic_time ();
+	priv->bus_error = LIBDDC_DEVICE_ERROR_NACK;
+	ret = priv->transport->read (device, addr, data, data_length, &len, &priv->bus_error, priv->transport_data, error);
+	libddc_device_stats_add_bus (device, g_get_monotonic_time () - start, 0, ret ? len : 0);
+	if (!ret)
+		goto out;
+
+	if (recieved_length != NULL)
+		*recieved_length = len;
+
+	if (priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+		libddc_device_print_hex_data ("Recv", data, len);
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_bus_transfer:
+ *
+ * Send several messages in one transaction if the transport allows it
+ **/
+static gboolean
+libddc_device_bus_transfer (LibddcDevice *device, LibddcDeviceMessage *msgs, guint n_msgs, GError **error)
+{
+	guint i;
+	gboolean ret = TRUE;
+	gint64 start;
+	gsize written = 0;
+	gsize read = 0;
+	LibddcDevicePrivate *priv = device->priv;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* send each message in turn */
+	if (priv->transport->transfer == NULL) {
+		for (i=0; i<n_msgs && ret; i++) {
+			if (msgs[i].read)
+				ret = libddc_device_bus_read (device, msgs[i].addr, msgs[i].data, msgs[i].length, NULL, error);
+			else
+				ret = libddc_device_bus_write (device, msgs[i].addr, msgs[i].data, msgs[i].length, error);
+		}
+		goto out;
+	}
+
+	start = g_get_monotonic_time ();
+	priv->bus_error = LIBDDC_DEVICE_ERROR_NACK;
+	ret = priv->transport->transfer (device, msgs, n_msgs, &priv->bus_error, priv->transport_data, error);
+	for (i=0; i<n_msgs && ret; i++) {
+		if (msgs[i].read)
+			read += msgs[i].length;
+		else
+			written += msgs[i].length;
+	}
+	libddc_device_stats_add_bus (device, g_get_monotonic_time () - start, written, read);
+	if (!ret)
+		goto out;
+
+	if (priv->verbose == LIBDDC_VERBOSE_PROTOCOL) {
+		for (i=0; i<n_msgs; i++)
+			libddc_device_print_hex_data (msgs[i].read ? "Recv" : "Send", msgs[i].data, msgs[i].length);
+	}
+out:
+	return ret;
+}
+
 /**
  * libddc_device_edid_valid:
  **/
@@ -209,35 +535,73 @@ libddc_device_edid_valid (const guint8 *data, gsize length)
 }
 
 /**
- * libddc_device_ensure_edid:
+ * libddc_device_read_edid_sysfs:
+ *
+ * Gets the EDID the kernel already read for the connector, which needs no
+ * bus traffic at all
  **/
 static gboolean
-libddc_device_ensure_edid (LibddcDevice *device, GError **error)
+libddc_device_read_edid_sysfs (LibddcDevice *device)
 {
-	gboolean ret = FALSE;
-	GError *error_local = NULL;
-	gint addr = LIBDDC_DEFAULT_EDID_ADDR;
-	guchar buf[128];
-
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+	gboolean ret;
+	gchar *data = NULL;
+	gsize length = 0;
 
-	/* already done */
-	if (device->priv->has_edid)
-		return TRUE;
+	if (device->priv->edid_filename == NULL)
+		return FALSE;
+	ret = g_file_get_contents (device->priv->edid_filename, &data, &length, NULL);
+	if (!ret)
+		goto out;
 
-	/* send edid with offset zero */
-	buf[0] = 0;
-	if (!libddc_device_i2c_write (device, addr, buf, 1, &error_local)) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "failed to request EDID: %s", error_local->message);
-		g_error_free (error_local);
+	/* the file is empty when nothing is connected */
+	length -= length % LIBDDC_EDID_BLOCK_SIZE;
+	ret = length > 0 && libddc_device_edid_valid ((const guint8 *) data, length);
+	if (!ret)
 		goto out;
-	}
+	g_free (device->priv->edid_data);
+	device->priv->edid_data = (guint8 *) data;
+	device->priv->edid_length = length;
+	device->priv->edid_extensions = length / LIBDDC_EDID_BLOCK_SIZE - 1;
+	data = NULL;
+out:
+	g_free (data);
+	return ret;
+}
 
-	/* read out data */
-	device->priv->edid_data = g_new0 (guint8, 128);
-	if (!libddc_device_i2c_read (device, addr, device->priv->edid_data, 128, &device->priv->edid_length, &error_local)) {
+/**
+ * libddc_device_read_edid_i2c:
+ **/
+static gboolean
+libddc_device_read_edid_i2c (LibddcDevice *device, GError **error)
+{
+	gboolean ret = FALSE;
+	GError *error_local = NULL;
+	gint addr = LIBDDC_DEFAULT_EDID_ADDR;
+	guint i;
+	guint blocks;
+	guint n_msgs = 0;
+	guchar offset = 0;
+	guchar offset_ext = LIBDDC_EDID_BLOCK_SIZE;
+	guchar segments[LIBDDC_EDID_MAX_SEGMENTS];
+	LibddcDeviceMessage msgs[LIBDDC_EDID_MAX_SEGMENTS * 3];
+	guint8 *edid;
+
+	/* get the base block together with the offset in one transaction,
+	 * as only the base block says how many extensions follow */
+	device->priv->stats_kind = LIBDDC_DEVICE_STATS_KIND_EDID;
+	device->priv->stats[LIBDDC_DEVICE_STATS_KIND_EDID].transactions++;
+	edid = g_new0 (guint8, LIBDDC_EDID_BLOCK_SIZE);
+	g_free (device->priv->edid_data);
+	device->priv->edid_data = edid;
+	msgs[0].addr = addr;
+	msgs[0].read = FALSE;
+	msgs[0].data = &offset;
+	msgs[0].length = 1;
+	msgs[1].addr = addr;
+	msgs[1].read = TRUE;
+	msgs[1].data = edid;
+	msgs[1].length = LIBDDC_EDID_BLOCK_SIZE;
+	if (!libddc_device_bus_transfer (device, msgs, 2, &error_local)) {
 		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
 			     "failed to recieve EDID: %s", error_local->message);
 		g_error_free (error_local);
@@ -245,17 +609,85 @@ libddc_device_ensure_edid (LibddcDevice *device, GError **error)
 	}
 
 	/* check valid */
-	ret = libddc_device_edid_valid (device->priv->edid_data, device->priv->edid_length);
+	ret = libddc_device_edid_valid (edid, LIBDDC_EDID_BLOCK_SIZE);
 	if (!ret) {
 		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
 			     "corrupted EDID at 0x%02x", addr);
 		goto out;
 	}
 
-	/* get md5 hash */
+	/* get all the extension blocks in one more transaction, the first
+	 * from the second half of segment 0 and the rest using the segment
+	 * pointer */
+	blocks = MIN (edid[126] + 1, LIBDDC_EDID_MAX_SEGMENTS * 2);
+	if (blocks > 1) {
+		edid = g_realloc (edid, blocks * LIBDDC_EDID_BLOCK_SIZE);
+		device->priv->edid_data = edid;
+		msgs[n_msgs].addr = addr;
+		msgs[n_msgs].read = FALSE;
+		msgs[n_msgs].data = &offset_ext;
+		msgs[n_msgs++].length = 1;
+		msgs[n_msgs].addr = addr;
+		msgs[n_msgs].read = TRUE;
+		msgs[n_msgs].data = edid + LIBDDC_EDID_BLOCK_SIZE;
+		msgs[n_msgs++].length = LIBDDC_EDID_BLOCK_SIZE;
+		for (i=1; i * 2 < blocks; i++) {
+			segments[i] = i;
+			msgs[n_msgs].addr = LIBDDC_EDID_SEGMENT_ADDR;
+			msgs[n_msgs].read = FALSE;
+			msgs[n_msgs].data = &segments[i];
+			msgs[n_msgs++].length = 1;
+			msgs[n_msgs].addr = addr;
+			msgs[n_msgs].read = FALSE;
+			msgs[n_msgs].data = &offset;
+			msgs[n_msgs++].length = 1;
+			msgs[n_msgs].addr = addr;
+			msgs[n_msgs].read = TRUE;
+			msgs[n_msgs].data = edid + i * 2 * LIBDDC_EDID_BLOCK_SIZE;
+			msgs[n_msgs++].length = MIN (blocks - i * 2, 2) * LIBDDC_EDID_BLOCK_SIZE;
+		}
+		device->priv->stats[LIBDDC_DEVICE_STATS_KIND_EDID].transactions++;
+		ret = libddc_device_bus_transfer (device, msgs, n_msgs, &error_local);
+		if (!ret) {
+			g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+				     "failed to recieve EDID extensions: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
+	}
+	device->priv->edid_length = blocks * LIBDDC_EDID_BLOCK_SIZE;
+	device->priv->edid_extensions = blocks - 1;
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_ensure_edid:
+ **/
+static gboolean
+libddc_device_ensure_edid (LibddcDevice *device, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* already done */
+	if (device->priv->has_edid)
+		return TRUE;
+
+	/* only use the bus if the kernel does not have a copy */
+	if (!libddc_device_read_edid_sysfs (device)) {
+		ret = libddc_device_read_edid_i2c (device, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* get md5 hash of the base block, so the hash does not depend on
+	 * how many extensions we could read */
 	device->priv->edid_md5 = g_compute_checksum_for_data (G_CHECKSUM_MD5,
 							device->priv->edid_data,
-							device->priv->edid_length);
+							LIBDDC_EDID_BLOCK_SIZE);
 
 	/* print */
 	device->priv->pnpid = g_strdup_printf ("%c%c%c%02X%02X",
@@ -263,6 +695,9 @@ libddc_device_ensure_edid (LibddcDevice *device, GError **error)
 		 ((device->priv->edid_data[8] & 3) << 3) + (device->priv->edid_data[9] >> 5) + 'A' - 1,
 		 (device->priv->edid_data[9] & 31) + 'A' - 1, device->priv->edid_data[11], device->priv->edid_data[10]);
 	device->priv->has_edid = TRUE;
+
+	/* use faster timings if this display has been calibrated */
+	libddc_device_load_timings (device);
 out:
 	return ret;
 }
@@ -270,19 +705,81 @@ out:
 /**
  * libddc_device_wait_for_hardware:
  *
- * Stalls execution, allowing write transaction to complete
+ * Stalls execution until the bus is no longer busy with the previous command
  **/
 static void
 libddc_device_wait_for_hardware (LibddcDevice *device)
 {
-	gdouble elapsed;
+	gint64 now;
 	LibddcDevicePrivate *priv = device->priv;
 
-	/* only wait if enough time hasn't yet passed */
-	elapsed = g_timer_elapsed (priv->timer, NULL);
-	if (elapsed < priv->required_wait)
-		g_usleep ((priv->required_wait - elapsed) * G_USEC_PER_SEC);
-	g_timer_reset (priv->timer);
+	/* only wait if the deadline has not yet passed */
+	now = g_get_monotonic_time ();
+	if (now < priv->busy_until) {
+		g_usleep (priv->busy_until - now);
+		libddc_device_stats_add_sleep (device, g_get_monotonic_time () - now);
+	}
+}
+
+/**
+ * libddc_device_get_command_delay:
+ *
+ * Return value: the time in seconds the display is busy after this command
+ **/
+static gdouble
+libddc_device_get_command_delay (LibddcDevice *device, const guchar *data, gsize length)
+{
+	gdouble delay;
+
+	switch (data[0]) {
+	case LIBDDC_VCP_REQUEST:
+		delay = LIBDDC_VCP_REQUEST_DELAY_SECS;
+		break;
+	case LIBDDC_VCP_SET:
+	case LIBDDC_VCP_RESET:
+		delay = LIBDDC_VCP_SET_DELAY_SECS;
+		break;
+	case LIBDDC_CAPABILITIES_REQUEST:
+		delay = LIBDDC_CAPABILITIES_DELAY_SECS;
+		break;
+	case LIBDDC_TABLE_READ_REQUEST:
+		/* calibration only measures the short commands */
+		return LIBDDC_TABLE_READ_DELAY_SECS;
+	case LIBDDC_TABLE_WRITE:
+		return LIBDDC_TABLE_WRITE_DELAY_SECS;
+	case LIBDDC_SAVE_CURRENT_SETTINGS:
+		/* the display writes to its EEPROM, however fast it replies */
+		if (length == 1)
+			return LIBDDC_SAVE_DELAY_SECS;
+		delay = LIBDDC_WRITE_DELAY_SECS;
+		break;
+	default:
+		delay = LIBDDC_WRITE_DELAY_SECS;
+		break;
+	}
+
+	/* apply any calibration */
+	return delay * device->priv->write_delay / LIBDDC_WRITE_DELAY_SECS;
+}
+
+/**
+ * libddc_device_get_stats_kind:
+ **/
+static LibddcDeviceStatsKind
+libddc_device_get_stats_kind (const guchar *data)
+{
+	switch (data[0]) {
+	case LIBDDC_VCP_REQUEST:
+		return LIBDDC_DEVICE_STATS_KIND_GET;
+	case LIBDDC_VCP_SET:
+	case LIBDDC_VCP_RESET:
+		return LIBDDC_DEVICE_STATS_KIND_SET;
+	case LIBDDC_CAPABILITIES_REQUEST:
+		return LIBDDC_DEVICE_STATS_KIND_CAPABILITIES;
+	default:
+		break;
+	}
+	return LIBDDC_DEVICE_STATS_KIND_OTHER;
 }
 
 /**
@@ -297,10 +794,18 @@ libddc_device_write (LibddcDevice *device, guchar *data, gsize length, GError **
 	guchar buf[LIBDDC_MAX_MESSAGE_BYTES + 3];
 	unsigned xor;
 	gboolean ret;
+	gdouble delay;
 
 	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* the display will be busy for a time depending on the command */
+	delay = libddc_device_get_command_delay (device, data, length);
+
+	/* count the reply with the command */
+	device->priv->stats_kind = libddc_device_get_stats_kind (data);
+	device->priv->stats[device->priv->stats_kind].transactions++;
+
 	/* initial xor value */
 	xor = ((guchar)device->priv->addr << 1);
 
@@ -321,23 +826,26 @@ libddc_device_write (LibddcDevice *device, guchar *data, gsize length, GError **
 	libddc_device_wait_for_hardware (device);
 
 	/* write to device */
-	ret = libddc_device_i2c_write (device, device->priv->addr, buf, i, error);
+	ret = libddc_device_bus_write (device, device->priv->addr, buf, i, error);
 	if (!ret)
 		goto out;
 
-	/* we have to wait at least this much time before submitting another command */
-	libddc_device_set_required_wait (device, LIBDDC_WRITE_DELAY_SECS);
+	/* we have to wait at least this much time before submitting another
+	 * command, but there is no need to block until we actually do */
+	libddc_device_set_required_wait (device, delay);
 out:
 	return ret;
 }
 
 /**
- * libddc_device_read:
+ * libddc_device_read_frame:
  *
- * Read ddc/ci formatted frame from ddc/ci
+ * Read ddc/ci formatted frame from ddc/ci, setting @kind to the kind of
+ * failure so callers that pass a %NULL @error still know what went wrong
  **/
-gboolean
-libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
+static gboolean
+libddc_device_read_frame (LibddcDevice *device, guchar *data, gsize data_length, gsize *recieved_length,
+			  LibddcDeviceError *kind, GError **error)
 {
 	guchar buf[LIBDDC_MAX_MESSAGE_BYTES];
 	guchar xor = LIBDDC_MAGIC_XOR;
@@ -345,20 +853,20 @@ libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize
 	gsize len;
 	gboolean ret;
 
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
 	/* wait for previous write to complete */
 	libddc_device_wait_for_hardware (device);
 
 	/* get data */
-	ret = libddc_device_i2c_read (device, device->priv->addr, buf, data_length + 3, recieved_length, error);
-	if (!ret)
+	ret = libddc_device_bus_read (device, device->priv->addr, buf, data_length + 3, recieved_length, error);
+	if (!ret) {
+		*kind = device->priv->bus_error;
 		goto out;
+	}
 
 	/* validate answer */
 	if (buf[0] != device->priv->addr * 2) { /* busy ??? */
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+		*kind = LIBDDC_DEVICE_ERROR_BUSY;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_BUSY,
 			     "Invalid response, first byte is 0x%02x, should be 0x%02x",
 			     buf[0], device->priv->addr * 2);
 		if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
@@ -374,7 +882,8 @@ libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize
 
 	len = buf[1] & ~LIBDDC_MAGIC_BYTE2;
 	if (len > data_length || len > sizeof(buf)) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+		*kind = LIBDDC_DEVICE_ERROR_TOO_LONG;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_TOO_LONG,
 			     "Invalid response, length is %d, should be %d at most",
 			     len, data_length);
 		ret = FALSE;
@@ -385,7 +894,8 @@ libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize
 	for (i = 0; i < len + 3; i++)
 		xor ^= buf[i];
 	if (xor != 0) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+		*kind = LIBDDC_DEVICE_ERROR_CHECKSUM;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_CHECKSUM,
 			     "Invalid response, corrupted data - xor is 0x%02x, length 0x%02x", xor, len);
 		if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
 			libddc_device_print_hex_data ("Bugz", buf, data_length + 3);
@@ -393,359 +903,2164 @@ libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize
 		goto out;
 	}
 
+	/* the display has nothing to say yet */
+	if (len == 0) {
+		*kind = LIBDDC_DEVICE_ERROR_NULL_MESSAGE;
+		g_set_error_literal (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_NULL_MESSAGE,
+				     "Invalid response, null message");
+		ret = FALSE;
+		goto out;
+	}
+
 	/* copy payload data */
 	memcpy (data, buf + 2, len);
 	if (recieved_length != NULL)
 		*recieved_length = len;
 
 	/* we have to wait at least this much time before reading the results */
-	libddc_device_set_required_wait (device, LIBDDC_READ_DELAY_SECS);
+	libddc_device_set_required_wait (device, device->priv->read_delay);
 out:
 	return ret;
 }
 
 /**
- * libddc_device_capabilities_request:
+ * libddc_device_read:
  *
- * read capabilities raw data of ddc/ci
+ * Read ddc/ci formatted frame from ddc/ci
  **/
-static gint
-libddc_device_capabilities_request (LibddcDevice *device, guint offset, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
+gboolean
+libddc_device_read (LibddcDevice *device, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
 {
-	guchar buf[3];
+	LibddcDeviceError kind;
 
 	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	buf[0] = LIBDDC_CAPABILITIES_REQUEST;
-	buf[1] = offset >> 8;
-	buf[2] = offset & 255;
-
-	if (!libddc_device_write (device, buf, sizeof(buf), error))
-		return FALSE;
-
-	return libddc_device_read (device, data, data_length, recieved_length, error);
+	return libddc_device_read_frame (device, data, data_length, recieved_length, &kind, error);
 }
 
 /**
- * libddc_device_add_control:
+ * libddc_device_should_retry:
+ *
+ * Counts the failure, and if the policy allows another attempt makes the
+ * next command wait for as long as the policy says
+ *
+ * Return value: %TRUE if the command should be sent again
  **/
 static gboolean
-libddc_device_add_control (LibddcDevice *device, const gchar *index_str, const gchar *controls_str)
+libddc_device_should_retry (LibddcDevice *device, LibddcDeviceError kind, guint attempt)
 {
-	LibddcControl *control;
-	control = libddc_control_new ();
-	libddc_control_set_verbose (control, device->priv->verbose);
-	libddc_control_set_device (control, device);
-	libddc_control_parse (control, strtoul (index_str, NULL, 16), controls_str);
-	g_ptr_array_add (device->priv->controls, control);
+	gint64 busy_until;
+	LibddcDevicePrivate *priv = device->priv;
+
+	priv->error_count[kind]++;
+	if (attempt >= priv->retry_max[kind])
+		return FALSE;
+	priv->retry_count[kind]++;
+	busy_until = g_get_monotonic_time () + priv->retry_delay[kind] * G_USEC_PER_SEC;
+	priv->busy_until = MAX (priv->busy_until, busy_until);
+	if (priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+		g_debug ("retrying after error %i, attempt %u", kind, attempt + 1);
 	return TRUE;
 }
 
 /**
- * libddc_device_set_device_property:
+ * libddc_device_command_internal:
+ *
+ * Sends a command and reads the reply, retrying as the policy allows. If
+ * @error is %NULL this does not allocate memory.
  **/
 static gboolean
-libddc_device_set_device_property (LibddcDevice *device, const gchar *key, const gchar *value)
+libddc_device_command_internal (LibddcDevice *device, guchar *data, gsize length,
+				guchar *reply, gsize reply_length, gsize *recieved_length,
+				LibddcDeviceError *kind, GError **error)
 {
-	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
-		g_debug ("key=%s, value=%s", key, value);
-	if (g_strcmp0 (key, "type") == 0) {
-		if (g_strcmp0 (value, "lcd") == 0)
-			device->priv->kind = LIBDDC_DEVICE_KIND_LCD;
-		else if (g_strcmp0 (value, "crt") == 0)
-			device->priv->kind = LIBDDC_DEVICE_KIND_CRT;
-	} else if (g_strcmp0 (key, "model") == 0)
-		device->priv->model = g_strdup (value);
-	else if (g_strcmp0 (key, "vcp") == 0) {
-		guint i;
-		gchar *tmp;
-		gchar *index_str;
-		gchar *caps_str = NULL;
-		guint refcount = 0;
-
-		tmp = g_strdup (value);
-		index_str = tmp;
-		for (i=0; tmp[i] != '\0'; i++) {
-			if (tmp[i] == '(') {
-				tmp[i] = '\0';
-				refcount++;
-				caps_str = &tmp[i] + 1;
-			} else if (tmp[i] == ')') {
-				tmp[i] = '\0';
-				refcount--;
-			} else if (tmp[i] == ' ' && refcount == 0) {
-				tmp[i] = '\0';
-				libddc_device_add_control (device, index_str, caps_str);
-				index_str = &tmp[i] + 1;
-				caps_str = NULL;
-			}
-		}
-		libddc_device_add_control (device, index_str, caps_str);
+	gboolean ret;
+	guint attempt;
+	GError *error_local = NULL;
+	GError **error_tmp = error != NULL ? &error_local : NULL;
+
+	for (attempt = 0; ; attempt++) {
+		ret = libddc_device_write (device, data, length, error_tmp);
+		if (!ret)
+			*kind = device->priv->bus_error;
+		else if (reply_length > 0)
+			ret = libddc_device_read_frame (device, reply, reply_length,
+							recieved_length, kind, error_tmp);
+		if (ret)
+			break;
+		if (!libddc_device_should_retry (device, *kind, attempt))
+			break;
+		g_clear_error (&error_local);
 	}
-	return TRUE;
+	if (!ret && error != NULL)
+		g_propagate_error (error, error_local);
+	return ret;
 }
 
 /**
- * libddc_device_parse_caps:
+ * libddc_device_command:
+ * @device: a #LibddcDevice
+ * @data: the DDC/CI payload to send
+ * @length: the size of @data
+ * @reply: (allow-none): a caller-owned buffer for the reply
+ * @reply_length: the size of @reply, or 0 if no reply is expected
+ * @recieved_length: (out): the size of the reply, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Sends a command and reads the reply, if any. Failures are classified
+ * as a #LibddcDeviceError and retried according to the policy set with
+ * libddc_device_set_retry_policy().
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
  **/
-static gboolean
-libddc_device_parse_caps (LibddcDevice *device, const gchar *caps)
+gboolean
+libddc_device_command (LibddcDevice *device, guchar *data, gsize length,
+		       guchar *reply, gsize reply_length, gsize *recieved_length, GError **error)
 {
-	guint i;
-	gchar *tmp = g_strdup (caps);
-	gchar *key = tmp+1;
-	gchar *value = NULL;
-	guint refcount = 0;
+	LibddcDeviceError kind;
 
-	/* decode string */
-	for (i=1; tmp[i] != '\0'; i++) {
-		if (tmp[i] == '(') {
-			if (refcount++ == 0) {
-				tmp[i] = '\0';
-				value = &tmp[i+1];
-			}
-		} else if (tmp[i] == ')') {
-			if (--refcount == 0) {
-				tmp[i] = '\0';
-				libddc_device_set_device_property (device, key, value);
-				key = &tmp[i]+1;
-			}
-		}
-	}
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (reply != NULL || reply_length == 0, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	g_free (tmp);
-	return TRUE;
+	return libddc_device_command_internal (device, data, length, reply, reply_length,
+					       recieved_length, &kind, error);
 }
 
 /**
- * libddc_device_ensure_controls:
+ * libddc_device_set_retry_policy:
+ * @device: a #LibddcDevice
+ * @kind: the #LibddcDeviceError to set the policy for
+ * @retries: the number of times to send the command again, or 0 to fail
+ * @delay: the extra time in seconds to wait before each retry
+ *
+ * Sets how commands are retried after each kind of failure. By default
+ * a null message is retried after a short wait, a checksum failure is
+ * retried at once, and a NACK fails immediately.
+ *
+ * Since: 0.0.1
  **/
-static gboolean
-libddc_device_ensure_controls (LibddcDevice *device, GError **error)
+void
+libddc_device_set_retry_policy (LibddcDevice *device, LibddcDeviceError kind,
+				guint retries, gdouble delay)
 {
-	guchar buf[64];
-	gint offset = 0;
-	gsize len;
-	gint retries = 5;
-	GString *string;
-	gboolean ret = FALSE;
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (kind < LIBDDC_DEVICE_ERROR_LAST);
 
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+	device->priv->retry_max[kind] = retries;
+	device->priv->retry_delay[kind] = delay;
+}
 
-	/* already done */
-	if (device->priv->has_controls)
-		return TRUE;
+/**
+ * libddc_device_get_retry_stats:
+ * @device: a #LibddcDevice
+ * @kind: a #LibddcDeviceError
+ * @errors: (out): the number of failures of this kind, or %NULL
+ * @retries: (out): the number of those that were retried, or %NULL
+ *
+ * Gets how often commands have failed, and been retried, since the
+ * device was created.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_device_get_retry_stats (LibddcDevice *device, LibddcDeviceError kind,
+			       guint *errors, guint *retries)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (kind < LIBDDC_DEVICE_ERROR_LAST);
 
-	/* allocate space for the controls */
-	string = g_string_new ("");
-	do {
-		/* we're shit out of luck, Brian */
-		if (retries == 0)
-			goto out;
+	if (errors != NULL)
+		*errors = device->priv->error_count[kind];
+	if (retries != NULL)
+		*retries = device->priv->retry_count[kind];
+}
 
-		/* clear previous error */
-		g_clear_error (error);
+/**
+ * libddc_device_get_stats:
+ * @device: a #LibddcDevice
+ * @kind: a #LibddcDeviceStatsKind
+ * @stats: (out caller-allocates): the counters for @kind
+ *
+ * Gets the counters for one kind of transaction since the device was
+ * created or libddc_device_reset_stats() was called. The errors and
+ * retries are available from libddc_device_get_retry_stats().
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_device_get_stats (LibddcDevice *device, LibddcDeviceStatsKind kind, LibddcDeviceStats *stats)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (kind < LIBDDC_DEVICE_STATS_KIND_LAST);
+	g_return_if_fail (stats != NULL);
 
-		/* try to read */
-		ret = libddc_device_capabilities_request (device, offset, buf, sizeof(buf), &len, error);
-		if (!ret) {
-			if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-				g_warning ("Failed to read capabilities offset 0x%02x.", offset);
-			retries--;
-			continue;
-		}
+	*stats = device->priv->stats[kind];
+}
 
-		/* not enough data */
-		if (len < 3) {
-			if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-				g_warning ("Not enough capabilities data at offset 0x%02x.", offset);
-			retries--;
+/**
+ * libddc_device_reset_stats:
+ * @device: a #LibddcDevice
+ *
+ * Clears the transaction counters, and the error and retry counters.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_device_reset_stats (LibddcDevice *device)
+{
+	LibddcDevicePrivate *priv;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	priv = device->priv;
+	memset (priv->stats, 0, sizeof (priv->stats));
+	memset (priv->error_count, 0, sizeof (priv->error_count));
+	memset (priv->retry_count, 0, sizeof (priv->retry_count));
+}
+
+/**
+ * libddc_device_get_stats_bucket_limit:
+ * @bucket: the histogram bucket index
+ *
+ * Return value: the exclusive upper limit of the bucket in microseconds,
+ * or %G_MAXUINT64 for the last bucket
+ *
+ * Since: 0.0.1
+ **/
+guint64
+libddc_device_get_stats_bucket_limit (guint bucket)
+{
+	g_return_val_if_fail (bucket < LIBDDC_DEVICE_STATS_BUCKETS, 0);
+	return libddc_device_stats_buckets[bucket];
+}
+
+/**
+ * libddc_device_stats_kind_to_string:
+ * @kind: a #LibddcDeviceStatsKind
+ *
+ * Return value: a short name for @kind
+ *
+ * Since: 0.0.1
+ **/
+const gchar *
+libddc_device_stats_kind_to_string (LibddcDeviceStatsKind kind)
+{
+	switch (kind) {
+	case LIBDDC_DEVICE_STATS_KIND_GET:
+		return "get";
+	case LIBDDC_DEVICE_STATS_KIND_SET:
+		return "set";
+	case LIBDDC_DEVICE_STATS_KIND_CAPABILITIES:
+		return "capabilities";
+	case LIBDDC_DEVICE_STATS_KIND_EDID:
+		return "edid";
+	case LIBDDC_DEVICE_STATS_KIND_OTHER:
+		return "other";
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * libddc_device_error_to_string:
+ * @error: a #LibddcDeviceError
+ *
+ * Return value: a short name for @error
+ *
+ * Since: 0.0.1
+ **/
+const gchar *
+libddc_device_error_to_string (LibddcDeviceError error)
+{
+	switch (error) {
+	case LIBDDC_DEVICE_ERROR_FAILED:
+		return "failed";
+	case LIBDDC_DEVICE_ERROR_NACK:
+		return "nack";
+	case LIBDDC_DEVICE_ERROR_BUSY:
+		return "busy";
+	case LIBDDC_DEVICE_ERROR_NULL_MESSAGE:
+		return "null-message";
+	case LIBDDC_DEVICE_ERROR_CHECKSUM:
+		return "checksum";
+	case LIBDDC_DEVICE_ERROR_TOO_LONG:
+		return "too-long";
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * libddc_device_poll:
+ * @device: a #LibddcDevice
+ * @items: a caller-owned array with the id of each control to read
+ * @n_items: the number of items
+ *
+ * Reads the current and maximum value of each control into @items. Each
+ * failure is reported as a #LibddcPollStatus rather than a #GError, so
+ * once the display has been started up this never allocates memory and
+ * can be called from a monitoring loop for as long as required.
+ *
+ * Return value: the number of controls that were read successfully
+ **/
+guint
+libddc_device_poll (LibddcDevice *device, LibddcPollItem *items, guint n_items)
+{
+	gsize len;
+	guchar buf[8];
+	guint i;
+	guint ok = 0;
+	LibddcDeviceError kind;
+	LibddcPollItem *item;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), 0);
+	g_return_val_if_fail (items != NULL || n_items == 0, 0);
+
+	/* only allocates the first time */
+	if (!libddc_device_ensure_startup (device, NULL)) {
+		for (i=0; i<n_items; i++)
+			items[i].status = LIBDDC_POLL_STATUS_BUS_ERROR;
+		return 0;
+	}
+
+	for (i=0; i<n_items; i++) {
+		item = &items[i];
+		buf[0] = LIBDDC_VCP_REQUEST;
+		buf[1] = item->id;
+		if (!libddc_device_command_internal (device, buf, 2, buf, sizeof(buf), &len, &kind, NULL)) {
+			item->status = (kind == LIBDDC_DEVICE_ERROR_NACK || kind == LIBDDC_DEVICE_ERROR_FAILED) ?
+					LIBDDC_POLL_STATUS_BUS_ERROR : LIBDDC_POLL_STATUS_INVALID_REPLY;
 			continue;
 		}
 
-		/* check response */
-		if (buf[0] != LIBDDC_CAPABILITIES_REPLY) {
-			if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-				g_warning ("Not correct capabilities reply at offset 0x%02x.", offset);
-			retries--;
+		/* not a reply for this control */
+		if (len != sizeof(buf) || buf[0] != LIBDDC_VCP_REPLY || buf[2] != item->id) {
+			item->status = LIBDDC_POLL_STATUS_INVALID_REPLY;
 			continue;
 		}
-
-		/* check offset */
-		if ((buf[1] * 256 + buf[2]) != offset) {
-			if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
-				g_warning ("Not correct capabilities offset at offset 0x%02x.", offset);
-			retries--;
+		if (buf[1] != 0) {
+			item->status = LIBDDC_POLL_STATUS_UNSUPPORTED;
 			continue;
 		}
+		item->maximum = buf[4] * 256 + buf[5];
+		item->value = buf[6] * 256 + buf[7];
+		item->status = LIBDDC_POLL_STATUS_OK;
+		ok++;
+	}
+	return ok;
+}
 
-		/* add to results */
-		g_string_append_len (string, (const gchar *) buf + 3, len - 3);
-		offset += len - 3;
-		retries = 3;
-	} while (len != 3);
+/**
+ * libddc_device_get_timings_filename:
+ **/
+static gchar *
+libddc_device_get_timings_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "libddc", "timings.conf", NULL);
+}
 
-	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
-		g_debug ("raw caps: %s", string->str);
+/**
+ * libddc_device_load_timings:
+ *
+ * Use the delays found by an earlier calibration of this display, if any
+ **/
+static void
+libddc_device_load_timings (LibddcDevice *device)
+{
+	gchar *filename;
+	gdouble read_delay;
+	gdouble write_delay;
+	GKeyFile *keyfile;
+	GError *error = NULL;
+	LibddcDevicePrivate *priv = device->priv;
 
-	/* parse */
-	ret = libddc_device_parse_caps (device, string->str);
-	if (!ret) {
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "failed to parse caps");
+	keyfile = g_key_file_new ();
+	filename = libddc_device_get_timings_filename ();
+	if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL))
+		goto out;
+	if (!g_key_file_has_group (keyfile, priv->edid_md5))
 		goto out;
-	}
 
-	/* success */
-	device->priv->has_controls = TRUE;
+	read_delay = g_key_file_get_double (keyfile, priv->edid_md5, "ReadDelay", &error);
+	if (error != NULL)
+		goto out;
+	write_delay = g_key_file_get_double (keyfile, priv->edid_md5, "WriteDelay", &error);
+	if (error != NULL)
+		goto out;
+
+	/* never trust the file to make things slower or absurdly fast */
+	priv->read_delay = CLAMP (read_delay, LIBDDC_READ_DELAY_SECS * LIBDDC_CALIBRATE_MIN_FACTOR, LIBDDC_READ_DELAY_SECS);
+	priv->write_delay = CLAMP (write_delay, LIBDDC_WRITE_DELAY_SECS * LIBDDC_CALIBRATE_MIN_FACTOR, LIBDDC_WRITE_DELAY_SECS);
+	if (priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
+		g_debug ("using calibrated delays of %.1fms/%.1fms",
+			 priv->read_delay * 1000, priv->write_delay * 1000);
 out:
-	g_string_free (string, TRUE);
-	return ret;
+	if (error != NULL)
+		g_error_free (error);
+	g_free (filename);
+	g_key_file_free (keyfile);
 }
 
 /**
- * libddc_device_save:
+ * libddc_device_lock_cache:
+ *
+ * Other processes update the same cache files, so updates are serialized
+ * using a lock file next to @filename. The lock is dropped when the
+ * returned file descriptor is closed, even if the process crashes.
+ *
+ * Return value: the file descriptor of the lock file, or -1 for failure
+ **/
+static gint
+libddc_device_lock_cache (const gchar *filename, GError **error)
+{
+	gint fd;
+	gint rc;
+	gchar *lockname;
+
+	lockname = g_strdup_printf ("%s.lock", filename);
+	fd = g_open (lockname, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to open %s: %s", lockname, g_strerror (errno));
+		goto out;
+	}
+	do {
+		rc = flock (fd, LOCK_EX);
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to lock %s: %s", lockname, g_strerror (errno));
+		close (fd);
+		fd = -1;
+	}
+out:
+	g_free (lockname);
+	return fd;
+}
+
+/**
+ * libddc_device_save_timings:
+ **/
+static gboolean
+libddc_device_save_timings (LibddcDevice *device, GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *data = NULL;
+	gint lock_fd = -1;
+	gchar *dirname;
+	gchar *filename;
+	gsize length;
+	GKeyFile *keyfile;
+	LibddcDevicePrivate *priv = device->priv;
+
+	keyfile = g_key_file_new ();
+	filename = libddc_device_get_timings_filename ();
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) < 0) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		goto out;
+	}
+
+	/* another display may be saving its timings at the same time */
+	lock_fd = libddc_device_lock_cache (filename, error);
+	if (lock_fd < 0)
+		goto out;
+
+	/* keep the timings of the other displays */
+	g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_KEEP_COMMENTS, NULL);
+	g_key_file_set_double (keyfile, priv->edid_md5, "ReadDelay", priv->read_delay);
+	g_key_file_set_double (keyfile, priv->edid_md5, "WriteDelay", priv->write_delay);
+	data = g_key_file_to_data (keyfile, &length, error);
+	if (data == NULL)
+		goto out;
+	ret = g_file_set_contents (filename, data, length, error);
+out:
+	if (lock_fd >= 0)
+		close (lock_fd);
+	g_free (data);
+	g_free (dirname);
+	g_free (filename);
+	g_key_file_free (keyfile);
+	return ret;
+}
+
+/**
+ * libddc_device_set_delay_factor:
+ **/
+static void
+libddc_device_set_delay_factor (LibddcDevice *device, gdouble factor)
+{
+	device->priv->read_delay = LIBDDC_READ_DELAY_SECS * factor;
+	device->priv->write_delay = LIBDDC_WRITE_DELAY_SECS * factor;
+}
+
+/**
+ * libddc_device_calibrate_probe:
+ *
+ * Return value: %TRUE if the display returned a well formed VCP reply
+ **/
+static gboolean
+libddc_device_calibrate_probe (LibddcDevice *device)
+{
+	guchar buf[8];
+	gsize len;
+
+	/* we only care about the framing, not if the control is supported */
+	buf[0] = LIBDDC_VCP_REQUEST;
+	buf[1] = LIBDDC_CONTROL_ID_BRIGHTNESS;
+	if (!libddc_device_write (device, buf, 2, NULL))
+		return FALSE;
+	if (!libddc_device_read (device, buf, sizeof(buf), &len, NULL))
+		return FALSE;
+	return (len == sizeof(buf) && buf[0] == LIBDDC_VCP_REPLY);
+}
+
+/**
+ * libddc_device_calibrate:
+ * @device: a #LibddcDevice
+ * @error: a #GError, or %NULL
+ *
+ * Finds the shortest delays between commands that this display handles
+ * reliably by probing it with shrinking delays. A safety margin is then
+ * added and the result is saved for this EDID, so that future calls to
+ * libddc_device_open() use the faster timings automatically.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+libddc_device_calibrate (LibddcDevice *device, GError **error)
+{
+	guint i;
+	gboolean ret;
+	gdouble factor;
+	gdouble safe = 0.0f;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* the results are keyed on the EDID */
+	ret = libddc_device_ensure_edid (device, error);
+	if (!ret)
+		goto out;
+
+	/* shrink the delays until the replies start getting corrupted */
+	for (factor = 1.0f; factor >= LIBDDC_CALIBRATE_MIN_FACTOR; factor *= LIBDDC_CALIBRATE_STEP) {
+		libddc_device_set_delay_factor (device, factor);
+		for (i=0; i<LIBDDC_CALIBRATE_PROBES; i++) {
+			if (!libddc_device_calibrate_probe (device))
+				break;
+		}
+		if (i < LIBDDC_CALIBRATE_PROBES)
+			break;
+		safe = factor;
+	}
+
+	/* let the display recover from any failed probe */
+	libddc_device_set_delay_factor (device, 1.0f);
+	libddc_device_set_required_wait (device, device->priv->write_delay);
+
+	/* not even the worst case timings work */
+	if (safe == 0.0f) {
+		ret = FALSE;
+		g_set_error_literal (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+				     "device did not reply using the default delays");
+		goto out;
+	}
+
+	/* add a margin as the display may be slower when busy */
+	libddc_device_set_delay_factor (device, MIN (safe * LIBDDC_CALIBRATE_MARGIN, 1.0f));
+	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
+		g_debug ("calibrated delays to %.1fms/%.1fms",
+			 device->priv->read_delay * 1000, device->priv->write_delay * 1000);
+
+	/* save for next time */
+	ret = libddc_device_save_timings (device, error);
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_get_delays:
+ * @device: a #LibddcDevice
+ * @read_delay: the time in seconds to wait after a read, or %NULL
+ * @write_delay: the time in seconds to wait after a write, or %NULL
+ *
+ * Gets the delays currently used between commands.
+ **/
+void
+libddc_device_get_delays (LibddcDevice *device, gdouble *read_delay, gdouble *write_delay)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	if (read_delay != NULL)
+		*read_delay = device->priv->read_delay;
+	if (write_delay != NULL)
+		*write_delay = device->priv->write_delay;
+}
+
+/**
+ * LibddcDeviceCommand:
+ *
+ * A command waiting to be sent on the bus
+ **/
+typedef struct {
+	guchar			 buf[LIBDDC_MAX_MESSAGE_BYTES];
+	gsize			 length;
+	gsize			 reply_length;
+	gboolean		 written;
+	gboolean		 retry;
+	guint			 attempt;
+	gint64			 wait_start;
+} LibddcDeviceCommand;
+
+static void libddc_device_command_step (GTask *task);
+static void libddc_device_startup_wait (LibddcDevice *device, GTask *task);
+
+/**
+ * libddc_device_command_done:
+ *
+ * Start the next queued command, if any
+ **/
+static void
+libddc_device_command_done (LibddcDevice *device, GTask *task)
+{
+	GTask *next;
+
+	/* the next task keeps the device alive if this was the last ref */
+	g_queue_remove (device->priv->commands, task);
+	next = g_queue_peek_head (device->priv->commands);
+	g_object_unref (task);
+	if (next != NULL)
+		libddc_device_command_step (next);
+}
+
+/**
+ * libddc_device_command_step_cb:
+ **/
+static gboolean
+libddc_device_command_step_cb (gpointer user_data)
+{
+	libddc_device_command_step (G_TASK (user_data));
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * libddc_device_command_step:
+ *
+ * Do the next part of the command, or schedule it for when the bus is free
+ **/
+static void
+libddc_device_command_step (GTask *task)
+{
+	gint64 now;
+	gsize len;
+	gboolean ret;
+	guchar reply[LIBDDC_MAX_MESSAGE_BYTES];
+	GSource *source;
+	GError *error = NULL;
+	LibddcDeviceError kind = LIBDDC_DEVICE_ERROR_NACK;
+	LibddcDevice *device = g_task_get_source_object (task);
+	LibddcDeviceCommand *cmd = g_task_get_task_data (task);
+
+	/* no point continuing */
+	if (g_task_return_error_if_cancelled (task))
+		goto out;
+
+	/* the display is still busy, so come back later */
+	now = g_get_monotonic_time ();
+	if (now < device->priv->busy_until) {
+		/* counted as sleep time when the command goes ahead */
+		if (cmd->wait_start == 0)
+			cmd->wait_start = now;
+
+		/* something else calls libddc_device_dispatch() */
+		if (device->priv->manual_dispatch)
+			return;
+		source = g_timeout_source_new ((device->priv->busy_until - now + 999) / 1000);
+		g_task_attach_source (task, source, libddc_device_command_step_cb);
+		g_source_unref (source);
+		return;
+	}
+
+	/* the wait was in the main loop, so libddc_device_write() will not
+	 * see it; a reply is counted with the command that asked for it */
+	if (cmd->wait_start != 0) {
+		if (!cmd->written)
+			device->priv->stats_kind = libddc_device_get_stats_kind (cmd->buf);
+		libddc_device_stats_add_sleep (device, now - cmd->wait_start);
+		cmd->wait_start = 0;
+	}
+
+	/* send the request */
+	if (!cmd->written) {
+		ret = libddc_device_write (device, cmd->buf, cmd->length, &error);
+		if (!ret) {
+			kind = device->priv->bus_error;
+			goto failed;
+		}
+		cmd->written = TRUE;
+
+		/* wait for the reply */
+		if (cmd->reply_length > 0) {
+			libddc_device_command_step (task);
+			return;
+		}
+		g_task_return_pointer (task, g_bytes_new (NULL, 0), (GDestroyNotify) g_bytes_unref);
+		goto out;
+	}
+
+	/* get the reply */
+	ret = libddc_device_read_frame (device, reply, cmd->reply_length, &len, &kind, &error);
+	if (!ret)
+		goto failed;
+	g_task_return_pointer (task, g_bytes_new (reply, len), (GDestroyNotify) g_bytes_unref);
+	goto out;
+failed:
+	/* send the whole command again when the bus is free */
+	if (cmd->retry && libddc_device_should_retry (device, kind, cmd->attempt++)) {
+		g_error_free (error);
+		cmd->written = FALSE;
+		libddc_device_command_step (task);
+		return;
+	}
+	g_task_return_error (task, error);
+out:
+	libddc_device_command_done (device, task);
+}
+
+/**
+ * libddc_device_command_new:
+ **/
+static GTask *
+libddc_device_command_new (LibddcDevice *device, const guchar *data, gsize length, gsize reply_length,
+			   gboolean retry, GCancellable *cancellable,
+			   GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+	LibddcDeviceCommand *cmd;
+
+	cmd = g_new0 (LibddcDeviceCommand, 1);
+	memcpy (cmd->buf, data, length);
+	cmd->length = length;
+	cmd->reply_length = reply_length;
+	cmd->retry = retry;
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	g_task_set_source_tag (task, libddc_device_command_async);
+	g_task_set_task_data (task, cmd, g_free);
+	return task;
+}
+
+/**
+ * libddc_device_command_queue:
+ *
+ * Queue a command without waiting for the startup command. Callers that
+ * retry by themselves pass %FALSE for @retry.
+ **/
+static void
+libddc_device_command_queue (LibddcDevice *device, const guchar *data, gsize length, gsize reply_length,
+			     gboolean retry, GCancellable *cancellable,
+			     GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+
+	/* the queue owns the task until it completes */
+	task = libddc_device_command_new (device, data, length, reply_length,
+					  retry, cancellable, callback, user_data);
+	g_queue_push_tail (device->priv->commands, task);
+	if (g_queue_get_length (device->priv->commands) == 1)
+		libddc_device_command_step (task);
+}
+
+/**
+ * libddc_device_command_async:
+ * @device: a #LibddcDevice
+ * @data: the DDC/CI payload to send
+ * @length: the size of @data
+ * @reply_length: the maximum size of the reply, or 0 if no reply is expected
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Sends a command to the display without blocking. The delays required
+ * by the display are done using timeouts in the thread-default main
+ * context, and commands are sent in the order they are queued.
+ *
+ * The first command sent to a display is preceded by the startup command
+ * some displays need, as with libddc_device_ensure_startup().
+ **/
+void
+libddc_device_command_async (LibddcDevice *device, const guchar *data, gsize length, gsize reply_length,
+			     GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (data != NULL);
+	g_return_if_fail (length > 0 && length <= LIBDDC_MAX_MESSAGE_BYTES);
+	g_return_if_fail (reply_length + 3 <= LIBDDC_MAX_MESSAGE_BYTES);
+
+	/* already started up */
+	if (device->priv->has_startup && device->priv->startup_waiters == NULL) {
+		libddc_device_command_queue (device, data, length, reply_length,
+					     TRUE, cancellable, callback, user_data);
+		return;
+	}
+
+	/* sent once the startup command is done */
+	task = libddc_device_command_new (device, data, length, reply_length,
+					  TRUE, cancellable, callback, user_data);
+	libddc_device_startup_wait (device, task);
+}
+
+/**
+ * libddc_device_command_finish:
+ * @device: a #LibddcDevice
+ * @res: the #GAsyncResult
+ * @error: a #GError, or %NULL
+ *
+ * Return value: the reply payload, which is empty if no reply was
+ * expected, or %NULL for failure. Free with g_bytes_unref().
+ **/
+GBytes *
+libddc_device_command_finish (LibddcDevice *device, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	g_return_val_if_fail (g_task_is_valid (res, device), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * libddc_device_capabilities_request:
+ *
+ * read capabilities raw data of ddc/ci
+ **/
+static gint
+libddc_device_capabilities_request (LibddcDevice *device, guint offset, guchar *data, gsize data_length, gsize *recieved_length, GError **error)
+{
+	guchar buf[3];
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	buf[0] = LIBDDC_CAPABILITIES_REQUEST;
+	buf[1] = offset >> 8;
+	buf[2] = offset & 255;
+
+	if (!libddc_device_write (device, buf, sizeof(buf), error))
+		return FALSE;
+
+	return libddc_device_read (device, data, data_length, recieved_length, error);
+}
+
+/**
+ * libddc_device_add_control:
+ **/
+static gboolean
+libddc_device_add_control (LibddcDevice *device, const gchar *index_str, const gchar *controls_str)
+{
+	guint64 id;
+	gchar *endptr = NULL;
+	LibddcControl *control;
+
+	/* displays pad with extra spaces and sometimes send junk */
+	id = g_ascii_strtoull (index_str, &endptr, 16);
+	if (endptr == index_str || *endptr != '\0' || id > 0xff) {
+		if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW && *index_str != '\0')
+			g_debug ("ignoring invalid control '%s'", index_str);
+		return FALSE;
+	}
+
+	control = libddc_control_new ();
+	libddc_control_set_verbose (control, device->priv->verbose);
+	libddc_control_set_device (control, device);
+	libddc_control_parse (control, id, controls_str);
+	g_ptr_array_add (device->priv->controls, control);
+	return TRUE;
+}
+
+/**
+ * libddc_device_set_device_property:
+ **/
+static gboolean
+libddc_device_set_device_property (LibddcDevice *device, const gchar *key, const gchar *value)
+{
+	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
+		g_debug ("key=%s, value=%s", key, value);
+	if (g_strcmp0 (key, "type") == 0) {
+		if (g_strcmp0 (value, "lcd") == 0)
+			device->priv->kind = LIBDDC_DEVICE_KIND_LCD;
+		else if (g_strcmp0 (value, "crt") == 0)
+			device->priv->kind = LIBDDC_DEVICE_KIND_CRT;
+	} else if (g_strcmp0 (key, "model") == 0) {
+		g_free (device->priv->model);
+		device->priv->model = g_strdup (value);
+	}
+	else if (g_strcmp0 (key, "vcp") == 0) {
+		guint i;
+		gchar *tmp;
+		gchar *index_str;
+		gchar *caps_str = NULL;
+		guint refcount = 0;
+
+		tmp = g_strdup (value);
+		index_str = tmp;
+		for (i=0; tmp[i] != '\0'; i++) {
+			if (tmp[i] == '(') {
+				tmp[i] = '\0';
+				refcount++;
+				caps_str = &tmp[i] + 1;
+			} else if (tmp[i] == ')') {
+				tmp[i] = '\0';
+				if (refcount > 0)
+					refcount--;
+			} else if (tmp[i] == ' ' && refcount == 0) {
+				tmp[i] = '\0';
+				libddc_device_add_control (device, index_str, caps_str);
+				index_str = &tmp[i] + 1;
+				caps_str = NULL;
+			}
+		}
+		libddc_device_add_control (device, index_str, caps_str);
+	}
+	return TRUE;
+}
+
+/**
+ * libddc_device_clear_controls:
+ **/
+static void
+libddc_device_clear_controls (LibddcDevice *device)
+{
+	guint i;
+	for (i=0; i<device->priv->controls->len; i++)
+		g_object_unref (g_ptr_array_index (device->priv->controls, i));
+	g_ptr_array_set_size (device->priv->controls, 0);
+	g_free (device->priv->model);
+	device->priv->model = NULL;
+	device->priv->kind = LIBDDC_DEVICE_KIND_UNKNOWN;
+	device->priv->has_controls = FALSE;
+}
+
+/**
+ * libddc_device_parse_caps:
+ **/
+static gboolean
+libddc_device_parse_caps (LibddcDevice *device, const gchar *caps)
+{
+	guint i;
+	gchar *tmp;
+	gchar *key;
+	gchar *value = NULL;
+	guint refcount = 0;
+
+	/* nothing that could be a property */
+	if (caps == NULL || strchr (caps, '(') == NULL)
+		return FALSE;
+
+	/* some displays leave out the outer brackets */
+	tmp = g_strdup (caps);
+	i = (tmp[0] == '(') ? 1 : 0;
+	key = &tmp[i];
+
+	/* decode string */
+	for (; tmp[i] != '\0'; i++) {
+		if (tmp[i] == '(') {
+			if (refcount++ == 0) {
+				tmp[i] = '\0';
+				value = &tmp[i+1];
+			}
+		} else if (tmp[i] == ')') {
+			/* the closing outer bracket, or junk */
+			if (refcount == 0) {
+				key = &tmp[i]+1;
+				continue;
+			}
+			if (--refcount == 0) {
+				tmp[i] = '\0';
+				libddc_device_set_device_property (device, g_strstrip (key), value);
+				key = &tmp[i]+1;
+			}
+		}
+	}
+
+	g_free (tmp);
+	return TRUE;
+}
+
+/**
+ * libddc_device_capabilities_reply_valid:
+ **/
+static gboolean
+libddc_device_capabilities_reply_valid (LibddcDevice *device, guint offset, const guchar *buf, gsize len)
+{
+	/* not enough data */
+	if (len < 3) {
+		if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+			g_warning ("Not enough capabilities data at offset 0x%02x.", offset);
+		return FALSE;
+	}
+
+	/* check response */
+	if (buf[0] != LIBDDC_CAPABILITIES_REPLY) {
+		if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+			g_warning ("Not correct capabilities reply at offset 0x%02x.", offset);
+		return FALSE;
+	}
+
+	/* check offset */
+	if ((guint) (buf[1] * 256 + buf[2]) != offset) {
+		if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+			g_warning ("Not correct capabilities offset at offset 0x%02x.", offset);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * libddc_device_get_caps_filename:
+ **/
+static gchar *
+libddc_device_get_caps_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "libddc", "capabilities.conf", NULL);
+}
+
+/**
+ * libddc_device_load_caps:
+ *
+ * Use the capabilities string saved when this display was last used, if any
+ **/
+static gboolean
+libddc_device_load_caps (LibddcDevice *device)
+{
+	gboolean ret = FALSE;
+	gchar *caps = NULL;
+	gchar *filename;
+	GKeyFile *keyfile;
+
+	if (!device->priv->use_cache)
+		return FALSE;
+
+	/* the cache is keyed on the EDID, which is usually in sysfs */
+	if (!libddc_device_ensure_edid (device, NULL))
+		return FALSE;
+
+	keyfile = g_key_file_new ();
+	filename = libddc_device_get_caps_filename ();
+	if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL))
+		goto out;
+	caps = g_key_file_get_string (keyfile, device->priv->edid_md5, "Capabilities", NULL);
+	if (caps == NULL)
+		goto out;
+	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
+		g_debug ("cached caps: %s", caps);
+	ret = libddc_device_parse_caps (device, caps);
+	if (!ret)
+		goto out;
+	device->priv->has_controls = TRUE;
+out:
+	g_free (caps);
+	g_free (filename);
+	g_key_file_free (keyfile);
+	return ret;
+}
+
+/**
+ * libddc_device_save_caps:
+ **/
+static gboolean
+libddc_device_save_caps (LibddcDevice *device, const gchar *caps, GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *data = NULL;
+	gint lock_fd = -1;
+	gchar *dirname;
+	gchar *filename;
+	gsize length;
+	GKeyFile *keyfile;
+
+	keyfile = g_key_file_new ();
+	filename = libddc_device_get_caps_filename ();
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) < 0) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		goto out;
+	}
+
+	/* the file is replaced atomically, but another process may be
+	 * about to replace it with what it loaded before this is saved */
+	lock_fd = libddc_device_lock_cache (filename, error);
+	if (lock_fd < 0)
+		goto out;
+
+	/* keep the capabilities of the other displays */
+	g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_KEEP_COMMENTS, NULL);
+	if (caps != NULL)
+		g_key_file_set_string (keyfile, device->priv->edid_md5, "Capabilities", caps);
+	else
+		g_key_file_remove_group (keyfile, device->priv->edid_md5, NULL);
+	data = g_key_file_to_data (keyfile, &length, error);
+	if (data == NULL)
+		goto out;
+	ret = g_file_set_contents (filename, data, length, error);
+out:
+	if (lock_fd >= 0)
+		close (lock_fd);
+	g_free (data);
+	g_free (dirname);
+	g_free (filename);
+	g_key_file_free (keyfile);
+	return ret;
+}
+
+/**
+ * libddc_device_set_caps:
+ *
+ * Parse the complete capabilities string into controls
+ **/
+static gboolean
+libddc_device_set_caps (LibddcDevice *device, const gchar *caps, GError **error)
+{
+	gboolean ret;
+	GError *error_local = NULL;
+
+	if (device->priv->verbose == LIBDDC_VERBOSE_OVERVIEW)
+		g_debug ("raw caps: %s", caps);
+
+	/* parse */
+	ret = libddc_device_parse_caps (device, caps);
+	if (!ret) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to parse caps");
+		goto out;
+	}
+
+	/* success */
+	device->priv->has_controls = TRUE;
+
+	/* save for next time, which is not fatal if it fails */
+	if (device->priv->use_cache && libddc_device_ensure_edid (device, NULL)) {
+		if (!libddc_device_save_caps (device, caps, &error_local)) {
+			g_warning ("failed to save caps: %s", error_local->message);
+			g_error_free (error_local);
+		}
+	}
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_ensure_controls:
+ **/
+static gboolean
+libddc_device_ensure_controls (LibddcDevice *device, GError **error)
+{
+	guchar buf[LIBDDC_CAPS_FRAGMENT_MAX];
+	gint offset = 0;
+	gsize len = 0;
+	guint failures = 0;
+	GString *string;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* already done */
+	if (device->priv->has_controls)
+		return TRUE;
+
+	/* no need to ask the display again */
+	if (libddc_device_load_caps (device))
+		return TRUE;
+
+	/* allocate space for the controls */
+	string = g_string_new ("");
+	do {
+		/* we're shit out of luck, Brian */
+		if (failures == LIBDDC_CAPS_RETRIES) {
+			if (error == NULL || *error == NULL) {
+				g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+					     "invalid capabilities reply at offset 0x%02x", offset);
+			}
+			goto out;
+		}
+
+		/* clear previous error */
+		g_clear_error (error);
+
+		/* try to read */
+		ret = libddc_device_capabilities_request (device, offset, buf, sizeof(buf), &len, error);
+		if (!ret) {
+			if (device->priv->verbose == LIBDDC_VERBOSE_PROTOCOL)
+				g_warning ("Failed to read capabilities offset 0x%02x.", offset);
+			libddc_device_backoff (device, failures++);
+			continue;
+		}
+
+		/* check response */
+		ret = libddc_device_capabilities_reply_valid (device, offset, buf, len);
+		if (!ret) {
+			libddc_device_backoff (device, failures++);
+			continue;
+		}
+
+		/* add to results */
+		g_string_append_len (string, (const gchar *) buf + 3, len - 3);
+		offset += len - 3;
+		failures = 0;
+		device->priv->caps_fragments++;
+		device->priv->caps_bytes += len - 3;
+	} while (len != 3);
+
+	/* parse */
+	ret = libddc_device_set_caps (device, string->str, error);
+out:
+	g_string_free (string, TRUE);
+	return ret;
+}
+
+/**
+ * libddc_device_save:
+ **/
+gboolean
+libddc_device_save (LibddcDevice *device, GError **error)
+{
+	gboolean ret = FALSE;
+	LibddcControl *control;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* get control */
+	control = libddc_device_get_control_by_id (device, LIBDDC_SAVE_CURRENT_SETTINGS, error);
+	if (control == NULL)
+		goto out;
+
+	/* run it, the next command waits for the EEPROM to be written */
+	ret = libddc_control_run (control, error);
+	g_object_unref (control);
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_startup:
+ **/
+static gboolean
+libddc_device_startup (LibddcDevice *device, GError **error)
+{
+	LibddcControl *control;
+	gboolean ret = FALSE;
+	if (device->priv->pnpid != NULL && g_str_has_prefix (device->priv->pnpid, "SAM")) {
+		control = libddc_device_get_control_by_id (device, LIBDDC_ENABLE_APPLICATION_REPORT, error);
+		if (control == NULL)
+			goto out;
+		ret = libddc_control_set (control, LIBDDC_CTRL_ENABLE, error);
+	} else {
+		/* this is not fatal if it's not found */
+		control = libddc_device_get_control_by_id (device, LIBDDC_COMMAND_PRESENCE, NULL);
+		if (control == NULL) {
+			ret = TRUE;
+			goto out;
+		}
+		ret = libddc_control_run (control, error);
+	}
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_ensure_startup:
+ * @device: a #LibddcDevice
+ * @error: a #GError, or %NULL
+ *
+ * Sends the command that some displays need before they accept control
+ * changes. This is done on the first control command rather than when
+ * the device is opened, so listing displays does not talk to them.
+ *
+ * Return value: %TRUE if the display is ready for control commands
  **/
 gboolean
-libddc_device_save (LibddcDevice *device, GError **error)
+libddc_device_ensure_startup (LibddcDevice *device, GError **error)
 {
-	gboolean ret = FALSE;
-	LibddcControl *control;
+	gboolean ret;
 
 	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* get control */
-	control = libddc_device_get_control_by_id (device, LIBDDC_SAVE_CURRENT_SETTINGS, error);
-	if (control == NULL)
-		goto out;
+	/* already done, or in progress */
+	if (device->priv->has_startup)
+		return TRUE;
+	device->priv->has_startup = TRUE;
 
-	/* run it */
-	ret = libddc_control_run (control, error);
+	/* need edid for pnpid */
+	ret = libddc_device_ensure_edid (device, error);
 	if (!ret)
 		goto out;
 
-	/* super long delay to allow for saving to eeprom */
-	g_usleep (LIBDDC_SAVE_DELAY_USECS);
+	/* startup for samsung mode */
+	ret = libddc_device_startup (device, error);
+out:
+	device->priv->has_startup = ret;
+	return ret;
+}
+
+/**
+ * libddc_device_close:
+ **/
+gboolean
+libddc_device_close (LibddcDevice *device, GError **error)
+{
+	LibddcControl *control;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* never started up, so nothing to undo */
+	if (device->priv->has_startup &&
+	    device->priv->pnpid != NULL && g_str_has_prefix (device->priv->pnpid, "SAM")) {
+		control = libddc_device_get_control_by_id (device, LIBDDC_ENABLE_APPLICATION_REPORT, error);
+		if (control == NULL)
+			goto out;
+		ret = libddc_control_set (control, LIBDDC_CTRL_DISABLE, error);
+	} else {
+		ret = TRUE;
+	}
 out:
 	return ret;
 }
 
 /**
- * libddc_device_startup:
+ * libddc_device_open:
+ **/
+gboolean
+libddc_device_open (LibddcDevice *device, const gchar *filename, GError **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* open bus, the EDID and the startup command are done on first use */
+	ret = device->priv->transport->open (device, filename, device->priv->transport_data, error);
+	return ret;
+}
+
+/**
+ * libddc_device_get_controls:
+ **/
+GPtrArray *
+libddc_device_get_controls (LibddcDevice *device, GError **error)
+{
+	gboolean ret;
+	GPtrArray *controls = NULL;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* get capabilities */
+	ret = libddc_device_ensure_controls (device, error);
+	if (!ret)
+		goto out;
+
+	/* success */
+	controls = g_ptr_array_ref (device->priv->controls);
+out:
+	return controls;
+}
+
+/**
+ * libddc_device_set_manual_dispatch:
+ * @device: a #LibddcDevice
+ * @manual_dispatch: %TRUE if the caller will dispatch queued commands
+ *
+ * By default each device adds its own timeout sources to wait for the
+ * display. When @manual_dispatch is set no sources are added, and the
+ * caller has to call libddc_device_dispatch() once the time returned by
+ * libddc_device_get_ready_time() has been reached. This allows one loop
+ * to drive many buses, for instance using #LibddcScheduler.
+ **/
+void
+libddc_device_set_manual_dispatch (LibddcDevice *device, gboolean manual_dispatch)
+{
+	GTask *task;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	if (device->priv->manual_dispatch == manual_dispatch)
+		return;
+	device->priv->manual_dispatch = manual_dispatch;
+
+	/* nothing will dispatch what is already queued otherwise */
+	task = g_queue_peek_head (device->priv->commands);
+	if (!manual_dispatch && task != NULL)
+		libddc_device_command_step (task);
+}
+
+/**
+ * libddc_device_get_ready_time:
+ * @device: a #LibddcDevice
+ *
+ * Return value: the monotonic time in microseconds when the next queued
+ * command can make progress, or -1 if no commands are queued
+ **/
+gint64
+libddc_device_get_ready_time (LibddcDevice *device)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), -1);
+
+	if (g_queue_is_empty (device->priv->commands))
+		return -1;
+	return device->priv->busy_until;
+}
+
+/**
+ * libddc_device_dispatch:
+ * @device: a #LibddcDevice
+ *
+ * Sends the next part of the first queued command if the display is
+ * ready for it. This never blocks.
+ *
+ * Return value: %TRUE if anything was sent or received
+ **/
+gboolean
+libddc_device_dispatch (LibddcDevice *device)
+{
+	GTask *task;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+
+	task = g_queue_peek_head (device->priv->commands);
+	if (task == NULL)
+		return FALSE;
+	if (g_get_monotonic_time () < device->priv->busy_until)
+		return FALSE;
+	libddc_device_command_step (task);
+	return TRUE;
+}
+
+/**
+ * LibddcDeviceCapsHelper:
+ **/
+typedef struct {
+	GString			*string;
+	guint			 offset;
+	guint			 failures;
+} LibddcDeviceCapsHelper;
+
+/**
+ * libddc_device_caps_helper_free:
+ **/
+static void
+libddc_device_caps_helper_free (LibddcDeviceCapsHelper *helper)
+{
+	g_string_free (helper->string, TRUE);
+	g_free (helper);
+}
+
+static void libddc_device_get_controls_fragment (GTask *task);
+static void libddc_device_get_controls_start (GTask *task);
+
+/**
+ * libddc_device_get_controls_done:
+ *
+ * Completes the fetch, and every caller that was waiting for it. This
+ * takes ownership of @error.
+ **/
+static void
+libddc_device_get_controls_done (LibddcDevice *device, GTask *task, GError *error)
+{
+	guint i;
+	GTask *waiter;
+	GPtrArray *waiters = device->priv->caps_waiters;
+
+	device->priv->caps_waiters = NULL;
+
+	/* only this caller gave up, so fetch again for the next one */
+	if (error != NULL &&
+	    g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+	    waiters->len > 0) {
+		g_task_return_error (task, error);
+		waiter = g_ptr_array_index (waiters, 0);
+		g_ptr_array_remove_index (waiters, 0);
+		device->priv->caps_waiters = waiters;
+		libddc_device_get_controls_start (waiter);
+		return;
+	}
+
+	for (i=0; i<waiters->len; i++) {
+		waiter = g_ptr_array_index (waiters, i);
+		if (error != NULL) {
+			g_task_return_error (waiter, g_error_copy (error));
+		} else {
+			g_task_return_pointer (waiter, g_ptr_array_ref (device->priv->controls),
+					       (GDestroyNotify) g_ptr_array_unref);
+		}
+		g_object_unref (waiter);
+	}
+	g_ptr_array_unref (waiters);
+
+	if (error != NULL) {
+		g_task_return_error (task, error);
+	} else {
+		g_task_return_pointer (task, g_ptr_array_ref (device->priv->controls),
+				       (GDestroyNotify) g_ptr_array_unref);
+	}
+}
+
+/**
+ * libddc_device_get_controls_cb:
+ **/
+static void
+libddc_device_get_controls_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gsize len = 0;
+	gboolean ret = FALSE;
+	const guchar *buf = NULL;
+	GBytes *bytes;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+	LibddcDevice *device = LIBDDC_DEVICE (source);
+	LibddcDeviceCapsHelper *helper = g_task_get_task_data (task);
+
+	/* cancelled is not worth retrying */
+	bytes = libddc_device_command_finish (device, res, &error);
+	if (bytes == NULL && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		libddc_device_get_controls_done (device, task, error);
+		goto out;
+	}
+
+	/* check response */
+	if (bytes != NULL) {
+		buf = g_bytes_get_data (bytes, &len);
+		ret = libddc_device_capabilities_reply_valid (device, helper->offset, buf, len);
+	}
+	if (!ret) {
+		/* we're shit out of luck, Brian */
+		if (++helper->failures == LIBDDC_CAPS_RETRIES) {
+			if (error == NULL) {
+				error = g_error_new (LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+						     "invalid capabilities reply at offset 0x%02x", helper->offset);
+			}
+			libddc_device_get_controls_done (device, task, error);
+			goto out;
+		}
+		g_clear_error (&error);
+		libddc_device_backoff (device, helper->failures - 1);
+		libddc_device_get_controls_fragment (task);
+		goto out_bytes;
+	}
+
+	/* no more data */
+	if (len == 3) {
+		ret = libddc_device_set_caps (device, helper->string->str, &error);
+		libddc_device_get_controls_done (device, task, ret ? NULL : error);
+		goto out;
+	}
+
+	/* add to results */
+	g_string_append_len (helper->string, (const gchar *) buf + 3, len - 3);
+	helper->offset += len - 3;
+	helper->failures = 0;
+	device->priv->caps_fragments++;
+	device->priv->caps_bytes += len - 3;
+	libddc_device_get_controls_fragment (task);
+	goto out_bytes;
+out:
+	g_object_unref (task);
+out_bytes:
+	if (bytes != NULL)
+		g_bytes_unref (bytes);
+}
+
+/**
+ * libddc_device_get_controls_fragment:
+ **/
+static void
+libddc_device_get_controls_fragment (GTask *task)
+{
+	guchar buf[3];
+	LibddcDevice *device = g_task_get_source_object (task);
+	LibddcDeviceCapsHelper *helper = g_task_get_task_data (task);
+
+	buf[0] = LIBDDC_CAPABILITIES_REQUEST;
+	buf[1] = helper->offset >> 8;
+	buf[2] = helper->offset & 255;
+	/* bad fragments are asked for again in libddc_device_get_controls_cb(),
+	 * with the same backoff as libddc_device_ensure_controls() */
+	libddc_device_command_queue (device, buf, sizeof(buf), LIBDDC_CAPS_FRAGMENT_MAX, FALSE,
+				     g_task_get_cancellable (task),
+				     libddc_device_get_controls_cb, task);
+}
+
+/**
+ * libddc_device_get_controls_async:
+ * @device: a #LibddcDevice
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets the controls from the display capabilities without blocking.
+ **/
+void
+libddc_device_get_controls_async (LibddcDevice *device, GCancellable *cancellable,
+				  GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	task = g_task_new (device, cancellable, callback, user_data);
+
+	/* already done, or saved from last time */
+	if (device->priv->has_controls || libddc_device_load_caps (device)) {
+		g_task_return_pointer (task, g_ptr_array_ref (device->priv->controls),
+				       (GDestroyNotify) g_ptr_array_unref);
+		g_object_unref (task);
+		return;
+	}
+
+	/* already being read for another caller */
+	if (device->priv->caps_waiters != NULL) {
+		g_ptr_array_add (device->priv->caps_waiters, task);
+		return;
+	}
+	device->priv->caps_waiters = g_ptr_array_new ();
+	libddc_device_get_controls_start (task);
+}
+
+/**
+ * libddc_device_get_controls_start:
+ **/
+static void
+libddc_device_get_controls_start (GTask *task)
+{
+	LibddcDeviceCapsHelper *helper;
+
+	helper = g_new0 (LibddcDeviceCapsHelper, 1);
+	helper->string = g_string_new ("");
+	g_task_set_task_data (task, helper, (GDestroyNotify) libddc_device_caps_helper_free);
+	libddc_device_get_controls_fragment (task);
+}
+
+/**
+ * libddc_device_get_controls_finish:
+ *
+ * Return value: an array of #LibddcControl, free with g_ptr_array_unref()
+ **/
+GPtrArray *
+libddc_device_get_controls_finish (LibddcDevice *device, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	g_return_val_if_fail (g_task_is_valid (res, device), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * libddc_device_find_control:
+ *
+ * Return value: the control with this ID, without a reference, or %NULL
+ **/
+static LibddcControl *
+libddc_device_find_control (LibddcDevice *device, guchar id)
+{
+	guint i;
+	LibddcControl *control;
+
+	for (i=0; i<device->priv->controls->len; i++) {
+		control = g_ptr_array_index (device->priv->controls, i);
+		if (libddc_control_get_id (control) == id)
+			return control;
+	}
+	return NULL;
+}
+
+/**
+ * libddc_device_boolean_cb:
+ *
+ * Completes a task with a boolean once the command has been sent
+ **/
+static void
+libddc_device_boolean_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *bytes;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+
+	bytes = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+	g_bytes_unref (bytes);
+	g_task_return_boolean (task, TRUE);
+out:
+	g_object_unref (task);
+}
+
+/**
+ * libddc_device_save_controls_cb:
+ **/
+static void
+libddc_device_save_controls_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	guchar buf[1];
+	GPtrArray *controls;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+	LibddcDevice *device = LIBDDC_DEVICE (source);
+
+	controls = libddc_device_get_controls_finish (device, res, &error);
+	if (controls == NULL) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+	g_ptr_array_unref (controls);
+
+	/* not supported */
+	if (libddc_device_find_control (device, LIBDDC_SAVE_CURRENT_SETTINGS) == NULL) {
+		g_task_return_new_error (task, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+					 "could not find a control id 0x%02x", LIBDDC_SAVE_CURRENT_SETTINGS);
+		g_object_unref (task);
+		return;
+	}
+
+	/* the next command waits for the EEPROM to be written */
+	buf[0] = LIBDDC_SAVE_CURRENT_SETTINGS;
+	libddc_device_command_async (device, buf, sizeof(buf), 0,
+				     g_task_get_cancellable (task),
+				     libddc_device_boolean_cb, task);
+}
+
+/**
+ * libddc_device_save_async:
+ * @device: a #LibddcDevice
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Saves the current settings to the display without blocking.
+ **/
+void
+libddc_device_save_async (LibddcDevice *device, GCancellable *cancellable,
+			  GAsyncReadyCallback callback, gpointer user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	libddc_device_get_controls_async (device, cancellable,
+					  libddc_device_save_controls_cb, task);
+}
+
+/**
+ * libddc_device_save_finish:
+ **/
+gboolean
+libddc_device_save_finish (LibddcDevice *device, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * libddc_device_startup_done:
+ *
+ * Send the commands that were waiting for the startup command, or fail them
+ **/
+static void
+libddc_device_startup_done (LibddcDevice *device, const GError *error)
+{
+	guint i;
+	guint queued;
+	GTask *task;
+	GPtrArray *waiters = device->priv->startup_waiters;
+
+	device->priv->startup_waiters = NULL;
+	device->priv->has_startup = (error == NULL);
+
+	/* queue the commands before any callback can queue more */
+	queued = g_queue_get_length (device->priv->commands);
+	for (i=0; error == NULL && i<waiters->len; i++)
+		g_queue_push_tail (device->priv->commands, g_ptr_array_index (waiters, i));
+	if (queued == 0 && !g_queue_is_empty (device->priv->commands))
+		libddc_device_command_step (g_queue_peek_head (device->priv->commands));
+
+	/* nothing can be sent to the display */
+	for (i=0; error != NULL && i<waiters->len; i++) {
+		task = g_ptr_array_index (waiters, i);
+		g_task_return_error (task, g_error_copy (error));
+		g_object_unref (task);
+	}
+	g_ptr_array_unref (waiters);
+}
+
+/**
+ * libddc_device_startup_cb:
+ **/
+static void
+libddc_device_startup_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *bytes;
+	GError *error = NULL;
+	LibddcDevice *device = LIBDDC_DEVICE (source);
+
+	bytes = libddc_device_command_finish (device, res, &error);
+	if (bytes != NULL)
+		g_bytes_unref (bytes);
+	libddc_device_startup_done (device, error);
+	if (error != NULL)
+		g_error_free (error);
+}
+
+/**
+ * libddc_device_startup_controls_cb:
  **/
-static gboolean
-libddc_device_startup (LibddcDevice *device, GError **error)
+static void
+libddc_device_startup_controls_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	LibddcControl *control;
-	gboolean ret = FALSE;
+	guchar buf[4];
+	gsize length;
+	GPtrArray *controls;
+	GError *error = NULL;
+	LibddcDevice *device = LIBDDC_DEVICE (source);
+
+	/* the startup command has to be in the capabilities */
+	controls = libddc_device_get_controls_finish (device, res, &error);
+	if (controls == NULL)
+		goto out;
+	g_ptr_array_unref (controls);
+
+	/* startup for samsung mode */
 	if (device->priv->pnpid != NULL && g_str_has_prefix (device->priv->pnpid, "SAM")) {
-		control = libddc_device_get_control_by_id (device, LIBDDC_ENABLE_APPLICATION_REPORT, error);
-		if (control == NULL)
+		if (libddc_device_find_control (device, LIBDDC_ENABLE_APPLICATION_REPORT) == NULL) {
+			g_set_error (&error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+				     "could not find a control id 0x%02x", LIBDDC_ENABLE_APPLICATION_REPORT);
 			goto out;
-		ret = libddc_control_set (control, LIBDDC_CTRL_ENABLE, error);
+		}
+		buf[0] = LIBDDC_VCP_SET;
+		buf[1] = LIBDDC_ENABLE_APPLICATION_REPORT;
+		buf[2] = LIBDDC_CTRL_ENABLE >> 8;
+		buf[3] = LIBDDC_CTRL_ENABLE & 255;
+		length = 4;
 	} else {
 		/* this is not fatal if it's not found */
-		control = libddc_device_get_control_by_id (device, LIBDDC_COMMAND_PRESENCE, NULL);
-		if (control == NULL) {
-			ret = TRUE;
+		if (libddc_device_find_control (device, LIBDDC_COMMAND_PRESENCE) == NULL)
 			goto out;
-		}
-		ret = libddc_control_run (control, error);
+		buf[0] = LIBDDC_COMMAND_PRESENCE;
+		length = 1;
 	}
+	libddc_device_command_queue (device, buf, length, 0, TRUE, NULL,
+				     libddc_device_startup_cb, NULL);
+	return;
 out:
-	return ret;
+	libddc_device_startup_done (device, error);
+	if (error != NULL)
+		g_error_free (error);
 }
 
 /**
- * libddc_device_close:
+ * libddc_device_startup_wait:
+ *
+ * Completes @task once the startup command has been sent. Command tasks
+ * are queued, anything else returns %TRUE.
  **/
-gboolean
-libddc_device_close (LibddcDevice *device, GError **error)
+static void
+libddc_device_startup_wait (LibddcDevice *device, GTask *task)
 {
-	LibddcControl *control;
-	gboolean ret = FALSE;
+	GError *error = NULL;
 
-	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+	/* the first caller starts it, everyone else waits for it */
+	if (device->priv->startup_waiters != NULL) {
+		g_ptr_array_add (device->priv->startup_waiters, task);
+		return;
+	}
+	device->priv->startup_waiters = g_ptr_array_new ();
+	g_ptr_array_add (device->priv->startup_waiters, task);
 
-	if (device->priv->pnpid != NULL && g_str_has_prefix (device->priv->pnpid, "SAM")) {
-		control = libddc_device_get_control_by_id (device, LIBDDC_ENABLE_APPLICATION_REPORT, error);
-		if (control == NULL)
-			goto out;
-		ret = libddc_control_set (control, LIBDDC_CTRL_DISABLE, error);
-	} else {
-		ret = TRUE;
+	/* sync commands must not send it as well */
+	device->priv->has_startup = TRUE;
+
+	/* need edid for pnpid */
+	if (!libddc_device_ensure_edid (device, &error)) {
+		libddc_device_startup_done (device, error);
+		g_error_free (error);
+		return;
 	}
-out:
-	return ret;
+
+	/* this is shared, so one caller cancelling must not stop it */
+	libddc_device_get_controls_async (device, NULL,
+					  libddc_device_startup_controls_cb, NULL);
 }
 
 /**
- * libddc_device_open:
+ * libddc_device_open_async:
+ * @device: a #LibddcDevice
+ * @filename: the bus to open, for instance "/dev/i2c-3"
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Opens the bus only; like libddc_device_open() the EDID is read and any
+ * startup command is sent when the first command is queued.
  **/
-gboolean
-libddc_device_open (LibddcDevice *device, const gchar *filename, GError **error)
+void
+libddc_device_open_async (LibddcDevice *device, const gchar *filename, GCancellable *cancellable,
+			  GAsyncReadyCallback callback, gpointer user_data)
 {
-	gboolean ret;
+	GTask *task;
+	GError *error = NULL;
 
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (filename != NULL);
+
+	task = g_task_new (device, cancellable, callback, user_data);
+
+	/* the EDID and the startup command wait for the first command */
+	if (!device->priv->transport->open (device, filename, device->priv->transport_data, &error)) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * libddc_device_open_finish:
+ **/
+gboolean
+libddc_device_open_finish (LibddcDevice *device, GAsyncResult *res, GError **error)
+{
 	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
-	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (g_task_is_valid (res, device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* ensure we have the module loaded */
-	ret = g_file_test ("/sys/module/i2c_dev/srcversion", G_FILE_TEST_EXISTS);
-	if (!ret) {
-		g_set_error_literal (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "unable to use I2C, you need to 'modprobe i2c-dev'");
-		goto out;
-	}
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
 
-	/* open file */
-	device->priv->fd = open (filename, O_RDWR);
-	if (device->priv->fd < 0) {
-		ret = FALSE;
-		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
-			     "failed to open: %i", device->priv->fd);
-		goto out;
-	}
+/**
+ * libddc_device_snapshot_skip:
+ *
+ * Controls that perform an action or change state when read, rather than
+ * reporting a setting, so have no place in a snapshot.
+ **/
+static const guchar libddc_device_snapshot_skip[] = {
+	0x01,	/* degauss */
+	0x02,	/* secondary-degauss, or new-control-value */
+	0x04,	/* reset-factory-defaults */
+	0x05,	/* reset-brightness-and-contrast */
+	0x06,	/* reset-factory-geometry */
+	0x08,	/* reset-factory-default-color */
+	0x0a,	/* reset-factory-default-position */
+	0x0c,	/* reset-factory-default-size */
+	0x52,	/* active-control, where reading drains the FIFO */
+	0xb0,	/* settings */
+	LIBDDC_VCP_ID_INVALID
+};
 
-	/* enable interface (need edid for pnpid) */
-	ret = libddc_device_ensure_edid (device, error);
-	if (!ret)
-		goto out;
+/**
+ * libddc_device_snapshot:
+ * @device: a #LibddcDevice
+ * @error: a #GError, or %NULL
+ *
+ * Reads every control in the capabilities that holds a setting, back to
+ * back and only waiting as long as the display needs between frames.
+ * Controls the display refuses to read are left out, and any that fail
+ * on the bus are counted with libddc_snapshot_get_failed().
+ *
+ * Return value: (transfer full): a #LibddcSnapshot, or %NULL for error
+ *
+ * Since: 0.0.1
+ **/
+LibddcSnapshot *
+libddc_device_snapshot (LibddcDevice *device, GError **error)
+{
+	const gchar *edid_md5;
+	guchar id;
+	guint failed = 0;
+	guint i, j;
+	guint n_items = 0;
+	GTimer *timer;
+	LibddcControl *control;
+	LibddcPollItem *items = NULL;
+	LibddcSnapshot *snapshot = NULL;
 
-	/* startup for samsung mode */
-	ret = libddc_device_startup (device, error);
-	if (!ret)
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	timer = g_timer_new ();
+	if (!libddc_device_ensure_controls (device, error))
 		goto out;
+	edid_md5 = libddc_device_get_edid_md5 (device, error);
+	if (edid_md5 == NULL)
+		goto out;
+
+	/* work out what to read before touching the bus */
+	items = g_new0 (LibddcPollItem, device->priv->controls->len);
+	for (i=0; i<device->priv->controls->len; i++) {
+		control = g_ptr_array_index (device->priv->controls, i);
+		id = libddc_control_get_id (control);
+		for (j=0; libddc_device_snapshot_skip[j] != LIBDDC_VCP_ID_INVALID; j++) {
+			if (libddc_device_snapshot_skip[j] == id)
+				break;
+		}
+		if (libddc_device_snapshot_skip[j] != LIBDDC_VCP_ID_INVALID)
+			continue;
+		items[n_items++].id = id;
+	}
+	libddc_device_poll (device, items, n_items);
+
+	/* only keep what was read */
+	snapshot = libddc_snapshot_new ();
+	libddc_snapshot_set_edid_md5 (snapshot, edid_md5);
+	for (i=0; i<n_items; i++) {
+		if (items[i].status == LIBDDC_POLL_STATUS_OK) {
+			libddc_snapshot_add (snapshot, items[i].id,
+					     items[i].value, items[i].maximum);
+		} else if (items[i].status != LIBDDC_POLL_STATUS_UNSUPPORTED) {
+			failed++;
+		}
+	}
+	libddc_snapshot_set_failed (snapshot, failed);
+	libddc_snapshot_set_elapsed (snapshot, g_timer_elapsed (timer, NULL));
 out:
-	return ret;
+	g_free (items);
+	g_timer_destroy (timer);
+	return snapshot;
 }
 
 /**
- * libddc_device_get_controls:
+ * libddc_device_reconcile:
+ * @device: a #LibddcDevice
+ * @target: a #LibddcSnapshot with the desired value of each control
+ * @flags: a #LibddcDeviceReconcileFlags, e.g. %LIBDDC_DEVICE_RECONCILE_FLAG_SAVE
+ * @error: a #GError, or %NULL
+ *
+ * Makes the display match @target, only writing the controls that differ.
+ * The current values are read unless remembered for longer than the
+ * maximum age of the control, or %LIBDDC_DEVICE_RECONCILE_FLAG_FORCE_READ
+ * is used. If %LIBDDC_DEVICE_RECONCILE_FLAG_SAVE is used, the settings
+ * are saved once at the end, and only if something was written.
+ *
+ * Every control in @target is resolved before anything is written, so
+ * an unknown control leaves the display untouched. Once writing, a
+ * control that cannot be read or written is counted with
+ * libddc_snapshot_get_failed() rather than stopping the others.
+ *
+ * Return value: (transfer full): a #LibddcSnapshot of the controls that
+ * were changed and their new values, or %NULL for error
+ *
+ * Since: 0.0.1
  **/
-GPtrArray *
-libddc_device_get_controls (LibddcDevice *device, GError **error)
+LibddcSnapshot *
+libddc_device_reconcile (LibddcDevice *device, LibddcSnapshot *target,
+			 LibddcDeviceReconcileFlags flags, GError **error)
 {
-	gboolean ret;
-	GPtrArray *controls = NULL;
+	const gchar *edid_md5;
+	guint failed = 0;
+	guint i;
+	guint16 value;
+	guint16 maximum;
+	GArray *entries;
+	GError *error_local = NULL;
+	GPtrArray *controls;
+	GTimer *timer;
+	LibddcControl *control;
+	LibddcControlRequestFlags request_flags = LIBDDC_CONTROL_REQUEST_FLAG_NONE;
+	LibddcSnapshot *changed = NULL;
+	LibddcSnapshotEntry *entry;
 
 	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(target), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	/* get capabilities */
-	ret = libddc_device_ensure_controls (device, error);
-	if (!ret)
+	timer = g_timer_new ();
+	controls = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+
+	/* never apply the settings of one display to another */
+	edid_md5 = libddc_device_get_edid_md5 (device, error);
+	if (edid_md5 == NULL)
+		goto out;
+	if (libddc_snapshot_get_edid_md5 (target) != NULL &&
+	    g_strcmp0 (libddc_snapshot_get_edid_md5 (target), edid_md5) != 0) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "target is for display %s, not %s",
+			     libddc_snapshot_get_edid_md5 (target), edid_md5);
 		goto out;
+	}
 
-	/* success */
-	controls = g_ptr_array_ref (device->priv->controls);
+	/* resolve everything before touching the display */
+	entries = libddc_snapshot_get_entries (target);
+	for (i=0; i<entries->len; i++) {
+		entry = &g_array_index (entries, LibddcSnapshotEntry, i);
+		control = libddc_device_get_control_by_id (device, entry->id, error);
+		if (control == NULL)
+			goto out;
+		g_ptr_array_add (controls, control);
+	}
+
+	/* only write what differs */
+	if ((flags & LIBDDC_DEVICE_RECONCILE_FLAG_FORCE_READ) > 0)
+		request_flags = LIBDDC_CONTROL_REQUEST_FLAG_FORCE;
+	changed = libddc_snapshot_new ();
+	libddc_snapshot_set_edid_md5 (changed, edid_md5);
+	for (i=0; i<entries->len; i++) {
+		entry = &g_array_index (entries, LibddcSnapshotEntry, i);
+		control = g_ptr_array_index (controls, i);
+		if (!libddc_control_request_full (control, request_flags,
+						  &value, &maximum, &error_local)) {
+			g_warning ("failed to read 0x%02x: %s", entry->id, error_local->message);
+			g_clear_error (&error_local);
+			failed++;
+			continue;
+		}
+		if (value == entry->value)
+			continue;
+		if (!libddc_control_set (control, entry->value, &error_local)) {
+			g_warning ("failed to write 0x%02x: %s", entry->id, error_local->message);
+			g_clear_error (&error_local);
+			failed++;
+			continue;
+		}
+		libddc_snapshot_add (changed, entry->id, entry->value, maximum);
+	}
+
+	/* the EEPROM is slow, so only write it once */
+	if ((flags & LIBDDC_DEVICE_RECONCILE_FLAG_SAVE) > 0 &&
+	    libddc_snapshot_get_entries (changed)->len > 0) {
+		if (!libddc_device_save (device, error)) {
+			g_object_unref (changed);
+			changed = NULL;
+			goto out;
+		}
+	}
+	libddc_snapshot_set_failed (changed, failed);
+	libddc_snapshot_set_elapsed (changed, g_timer_elapsed (timer, NULL));
 out:
-	return controls;
+	g_ptr_array_unref (controls);
+	g_timer_destroy (timer);
+	return changed;
 }
 
 /**
@@ -787,9 +3102,29 @@ out:
 
 /**
  * libddc_device_get_edid:
+ * @device: a #LibddcDevice
+ * @length: the size of the returned data, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Return value: the EDID including any extension blocks
  **/
 const guint8 *
 libddc_device_get_edid	(LibddcDevice *device, gsize *length, GError **error)
+{
+	return libddc_device_get_edid_full (device, length, NULL, error);
+}
+
+/**
+ * libddc_device_get_edid_full:
+ * @device: a #LibddcDevice
+ * @length: the size of the returned data, or %NULL
+ * @extensions: the number of extension blocks after the base block, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Return value: the EDID including any extension blocks
+ **/
+const guint8 *
+libddc_device_get_edid_full (LibddcDevice *device, gsize *length, guint *extensions, GError **error)
 {
 	gboolean ret;
 	const guint8 *data = NULL;
@@ -806,6 +3141,8 @@ libddc_device_get_edid	(LibddcDevice *device, gsize *length, GError **error)
 	data = device->priv->edid_data;
 	if (length != NULL)
 		*length = device->priv->edid_length;
+	if (extensions != NULL)
+		*extensions = device->priv->edid_extensions;
 out:
 	return data;
 }
@@ -856,6 +3193,181 @@ out:
 	return pnpid;
 }
 
+/**
+ * libddc_device_get_caps_stats:
+ * @device: a #LibddcDevice
+ * @fragments: (out): the number of capabilities fragments received, or %NULL
+ * @bytes: (out): the number of capabilities bytes received, or %NULL
+ * @retries: (out): the number of fragment requests that were retried, or %NULL
+ *
+ * Gets how the capabilities string was read from the display, which is
+ * useful to find displays that send small fragments or need many retries.
+ **/
+void
+libddc_device_get_caps_stats (LibddcDevice *device, guint *fragments, guint *bytes, guint *retries)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	if (fragments != NULL)
+		*fragments = device->priv->caps_fragments;
+	if (bytes != NULL)
+		*bytes = device->priv->caps_bytes;
+	if (retries != NULL)
+		*retries = device->priv->caps_retries;
+}
+
+/**
+ * libddc_device_set_use_cache:
+ * @device: a #LibddcDevice
+ * @use_cache: %FALSE to always read the capabilities from the display
+ *
+ * Sets whether the capabilities string saved in the user cache is used.
+ * Reading it from the display takes about a second.
+ **/
+void
+libddc_device_set_use_cache (LibddcDevice *device, gboolean use_cache)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	device->priv->use_cache = use_cache;
+}
+
+/**
+ * libddc_device_invalidate_cache:
+ * @device: a #LibddcDevice
+ * @error: a #GError, or %NULL
+ *
+ * Removes the saved capabilities of this display, for instance after a
+ * firmware update, so that they are read from the display next time.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+libddc_device_invalidate_cache (LibddcDevice *device, GError **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	ret = libddc_device_ensure_edid (device, error);
+	if (!ret)
+		goto out;
+	ret = libddc_device_save_caps (device, NULL, error);
+	if (!ret)
+		goto out;
+
+	/* forget what we have parsed */
+	libddc_device_clear_controls (device);
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_set_capabilities:
+ * @device: a #LibddcDevice
+ * @caps: a capabilities string, e.g. "(prot(monitor)type(lcd)vcp(10 12))"
+ * @error: a #GError, or %NULL
+ *
+ * Uses a capabilities string from elsewhere, for instance a database of
+ * display models, rather than reading it from the display. Any controls
+ * already parsed are forgotten.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+libddc_device_set_capabilities (LibddcDevice *device, const gchar *caps, GError **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), FALSE);
+	g_return_val_if_fail (caps != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	libddc_device_clear_controls (device);
+	ret = libddc_device_parse_caps (device, caps);
+	if (!ret) {
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED,
+			     "failed to parse caps");
+		goto out;
+	}
+	device->priv->has_controls = TRUE;
+out:
+	return ret;
+}
+
+/**
+ * libddc_device_set_store:
+ * @device: a #LibddcDevice
+ * @store: a #LibddcStore, or %NULL
+ *
+ * Sets where control values are recorded whenever they are read or
+ * written, so that other processes can use them.
+ **/
+void
+libddc_device_set_store (LibddcDevice *device, LibddcStore *store)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	if (device->priv->store != NULL)
+		g_object_unref (device->priv->store);
+	device->priv->store = store != NULL ? g_object_ref (store) : NULL;
+}
+
+/**
+ * libddc_device_get_store:
+ * @device: a #LibddcDevice
+ *
+ * Return value: (transfer none): the #LibddcStore, or %NULL if not set
+ **/
+LibddcStore *
+libddc_device_get_store (LibddcDevice *device)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	return device->priv->store;
+}
+
+/**
+ * libddc_device_set_connector:
+ * @device: a #LibddcDevice
+ * @connector: the DRM connector name, e.g. "DP-1"
+ *
+ * Sets the display output this device is attached to.
+ **/
+void
+libddc_device_set_connector (LibddcDevice *device, const gchar *connector)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_free (device->priv->connector);
+	device->priv->connector = g_strdup (connector);
+}
+
+/**
+ * libddc_device_get_connector:
+ * @device: a #LibddcDevice
+ *
+ * Return value: the DRM connector name, e.g. "DP-1", or %NULL if unknown
+ **/
+const gchar *
+libddc_device_get_connector (LibddcDevice *device)
+{
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+	return device->priv->connector;
+}
+
+/**
+ * libddc_device_set_edid_filename:
+ * @device: a #LibddcDevice
+ * @filename: a file with the raw EDID, e.g. "/sys/class/drm/card0-DP-1/edid"
+ *
+ * Sets where the EDID can be read without using the bus. If the file is
+ * missing or empty the EDID is read from the display as before.
+ **/
+void
+libddc_device_set_edid_filename (LibddcDevice *device, const gchar *filename)
+{
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_free (device->priv->edid_filename);
+	device->priv->edid_filename = g_strdup (filename);
+}
+
 /**
  * libddc_device_get_model:
  **/
@@ -912,6 +3424,33 @@ libddc_device_set_verbose (LibddcDevice *device, LibddcVerbose verbose)
 	device->priv->verbose = verbose;
 }
 
+/**
+ * libddc_device_set_transport:
+ * @device: a #LibddcDevice
+ * @transport: the bus operations to use
+ * @user_data: data to pass to each of the bus operations
+ * @destroy_func: a function to free @user_data, or %NULL
+ *
+ * Replaces the default i2c-dev transport, for instance with a simulated
+ * display. This has to be called before libddc_device_open().
+ **/
+void
+libddc_device_set_transport (LibddcDevice *device, const LibddcDeviceTransport *transport,
+			     gpointer user_data, GDestroyNotify destroy_func)
+{
+	LibddcDevicePrivate *priv;
+
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+	g_return_if_fail (transport != NULL);
+
+	priv = device->priv;
+	if (priv->transport_destroy != NULL)
+		priv->transport_destroy (priv->transport_data);
+	priv->transport = transport;
+	priv->transport_data = user_data;
+	priv->transport_destroy = destroy_func;
+}
+
 /**
  * libddc_device_error_quark:
  *
@@ -995,10 +3534,22 @@ libddc_device_init (LibddcDevice *device)
 	device->priv->kind = LIBDDC_DEVICE_KIND_UNKNOWN;
 	device->priv->addr = LIBDDC_DEFAULT_DDCCI_ADDR;
 	device->priv->controls = g_ptr_array_new ();
+	device->priv->use_cache = TRUE;
 	device->priv->fd = -1;
+	device->priv->transport = &libddc_device_i2c_transport;
 	/* assume the hardware is busy */
-	device->priv->required_wait = LIBDDC_WRITE_DELAY_SECS;
-	device->priv->timer = g_timer_new ();
+	device->priv->read_delay = LIBDDC_READ_DELAY_SECS;
+	device->priv->write_delay = LIBDDC_WRITE_DELAY_SECS;
+	libddc_device_set_required_wait (device, device->priv->write_delay);
+	device->priv->commands = g_queue_new ();
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_NULL_MESSAGE,
+					LIBDDC_RETRY_NULL_MESSAGE, LIBDDC_RETRY_NULL_MESSAGE_SECS);
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_BUSY,
+					LIBDDC_RETRY_BUSY, LIBDDC_RETRY_BUSY_SECS);
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_CHECKSUM,
+					LIBDDC_RETRY_CHECKSUM, 0.0f);
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_TOO_LONG,
+					LIBDDC_RETRY_TOO_LONG, 0.0f);
 }
 
 /**
@@ -1011,14 +3562,20 @@ libddc_device_finalize (GObject *object)
 	LibddcDevicePrivate *priv = device->priv;
 
 	g_return_if_fail (LIBDDC_IS_DEVICE(device));
-	if (priv->fd > 0)
-		close (priv->fd);
+	if (priv->transport->close != NULL)
+		priv->transport->close (device, priv->transport_data);
+	if (priv->transport_destroy != NULL)
+		priv->transport_destroy (priv->transport_data);
 	g_free (priv->model);
 	g_free (priv->pnpid);
+	g_free (priv->connector);
+	g_free (priv->edid_filename);
+	if (priv->store != NULL)
+		g_object_unref (priv->store);
 	g_free (priv->edid_data);
 	g_free (priv->edid_md5);
-	g_timer_destroy (priv->timer);
 	g_ptr_array_free (priv->controls, TRUE);
+	g_queue_free (priv->commands);
 
 	G_OBJECT_CLASS (libddc_device_parent_class)->finalize (object);
 }
@@ -31,6 +31,8 @@
 
 #include <libddc-common.h>
 #include <libddc-device.h>
+#include <libddc-snapshot.h>
+#include <libddc-store.h>
 
 G_BEGIN_DECLS
 
@@ -46,12 +48,23 @@ G_BEGIN_DECLS
 /**
  * LibddcDeviceError:
  * @LIBDDC_DEVICE_ERROR_FAILED: the transaction failed for an unknown reason
+ * @LIBDDC_DEVICE_ERROR_NACK: the bus transfer was not acknowledged
+ * @LIBDDC_DEVICE_ERROR_BUSY: the bus or the display was busy, e.g. the reply did not start with the display address
+ * @LIBDDC_DEVICE_ERROR_NULL_MESSAGE: the display sent a null message
+ * @LIBDDC_DEVICE_ERROR_CHECKSUM: the reply checksum was wrong
+ * @LIBDDC_DEVICE_ERROR_TOO_LONG: the reply was longer than expected
  *
  * Errors that can be thrown
  */
 typedef enum
 {
-	LIBDDC_DEVICE_ERROR_FAILED
+	LIBDDC_DEVICE_ERROR_FAILED,
+	LIBDDC_DEVICE_ERROR_NACK,
+	LIBDDC_DEVICE_ERROR_BUSY,
+	LIBDDC_DEVICE_ERROR_NULL_MESSAGE,
+	LIBDDC_DEVICE_ERROR_CHECKSUM,
+	LIBDDC_DEVICE_ERROR_TOO_LONG,
+	LIBDDC_DEVICE_ERROR_LAST
 } LibddcDeviceError;
 
 typedef struct _LibddcDevicePrivate		LibddcDevicePrivate;
@@ -84,6 +97,158 @@ typedef enum {
 	LIBDDC_DEVICE_KIND_UNKNOWN
 } LibddcDeviceKind;
 
+/**
+ * LibddcDeviceReconcileFlags:
+ * @LIBDDC_DEVICE_RECONCILE_FLAG_NONE: compare against remembered values
+ * @LIBDDC_DEVICE_RECONCILE_FLAG_FORCE_READ: always read the current values
+ * @LIBDDC_DEVICE_RECONCILE_FLAG_SAVE: save the settings if anything changed
+ *
+ * Flags used by libddc_device_reconcile()
+ */
+typedef enum {
+	LIBDDC_DEVICE_RECONCILE_FLAG_NONE		= 0,
+	LIBDDC_DEVICE_RECONCILE_FLAG_FORCE_READ		= 1 << 0,
+	LIBDDC_DEVICE_RECONCILE_FLAG_SAVE		= 1 << 1
+} LibddcDeviceReconcileFlags;
+
+/**
+ * LibddcDeviceStatsKind:
+ * @LIBDDC_DEVICE_STATS_KIND_GET: reading a control value
+ * @LIBDDC_DEVICE_STATS_KIND_SET: writing or resetting a control value
+ * @LIBDDC_DEVICE_STATS_KIND_CAPABILITIES: reading the capabilities
+ * @LIBDDC_DEVICE_STATS_KIND_EDID: reading the EDID over the bus
+ * @LIBDDC_DEVICE_STATS_KIND_OTHER: any other command
+ *
+ * The kinds of transaction counted separately by libddc_device_get_stats()
+ */
+typedef enum {
+	LIBDDC_DEVICE_STATS_KIND_GET,
+	LIBDDC_DEVICE_STATS_KIND_SET,
+	LIBDDC_DEVICE_STATS_KIND_CAPABILITIES,
+	LIBDDC_DEVICE_STATS_KIND_EDID,
+	LIBDDC_DEVICE_STATS_KIND_OTHER,
+	LIBDDC_DEVICE_STATS_KIND_LAST
+} LibddcDeviceStatsKind;
+
+#define LIBDDC_DEVICE_STATS_BUCKETS		8
+
+/**
+ * LibddcDeviceStats:
+ * @transactions: the number of commands sent
+ * @bytes_written: the number of bytes sent on the bus
+ * @bytes_read: the number of bytes received from the bus
+ * @sleep_time: the time spent waiting for the display, in microseconds
+ * @bus_time: the time spent in bus transfers, in microseconds
+ * @sleep_histogram: the number of waits in each bucket
+ * @bus_histogram: the number of bus transfers in each bucket
+ *
+ * Counters for one kind of transaction. The upper limit of each
+ * histogram bucket is given by libddc_device_get_stats_bucket_limit().
+ */
+typedef struct {
+	guint			 transactions;
+	guint64			 bytes_written;
+	guint64			 bytes_read;
+	guint64			 sleep_time;
+	guint64			 bus_time;
+	guint			 sleep_histogram[LIBDDC_DEVICE_STATS_BUCKETS];
+	guint			 bus_histogram[LIBDDC_DEVICE_STATS_BUCKETS];
+} LibddcDeviceStats;
+
+/**
+ * LibddcPollStatus:
+ * @LIBDDC_POLL_STATUS_OK: the value was read
+ * @LIBDDC_POLL_STATUS_BUS_ERROR: the bus transaction failed
+ * @LIBDDC_POLL_STATUS_INVALID_REPLY: the bus was busy, or the reply was corrupted or for another control
+ * @LIBDDC_POLL_STATUS_UNSUPPORTED: the display does not support the control
+ *
+ * The outcome of reading one control with libddc_device_poll()
+ */
+typedef enum {
+	LIBDDC_POLL_STATUS_OK,
+	LIBDDC_POLL_STATUS_BUS_ERROR,
+	LIBDDC_POLL_STATUS_INVALID_REPLY,
+	LIBDDC_POLL_STATUS_UNSUPPORTED
+} LibddcPollStatus;
+
+/**
+ * LibddcPollItem:
+ * @id: the control ID to read, set by the caller
+ * @value: the current value
+ * @maximum: the maximum value
+ * @status: the outcome, the other fields are only valid for %LIBDDC_POLL_STATUS_OK
+ *
+ * One control in a caller-owned libddc_device_poll() array
+ */
+typedef struct {
+	guchar			 id;
+	guint16			 value;
+	guint16			 maximum;
+	LibddcPollStatus	 status;
+} LibddcPollItem;
+
+/**
+ * LibddcDeviceMessage:
+ * @addr: the I2C slave address
+ * @read: %TRUE to read into @data, %FALSE to write from it
+ * @data: the buffer
+ * @length: the size of @data
+ *
+ * One part of a combined bus transaction.
+ */
+typedef struct {
+	guint		 addr;
+	gboolean	 read;
+	guchar		*data;
+	gsize		 length;
+} LibddcDeviceMessage;
+
+/**
+ * LibddcDeviceTransport:
+ * @open: open the bus, for instance "/dev/i2c-3"
+ * @read: read raw bytes from the I2C slave at @addr
+ * @write: write raw bytes to the I2C slave at @addr
+ * @close: close the bus, may be %NULL
+ * @transfer: perform several reads and writes as one bus transaction,
+ * may be %NULL in which case each message is sent in turn
+ *
+ * The bus operations used by a #LibddcDevice. By default the kernel
+ * i2c-dev interface is used, but this can be replaced for testing.
+ *
+ * On failure @read, @write and @transfer set @kind to say whether the
+ * transfer is worth retrying, as the caller may not have asked for a
+ * #GError. If it is left alone %LIBDDC_DEVICE_ERROR_NACK is assumed.
+ */
+typedef struct {
+	gboolean	(*open)		(LibddcDevice	*device,
+					 const gchar	*filename,
+					 gpointer	 user_data,
+					 GError		**error);
+	gboolean	(*read)		(LibddcDevice	*device,
+					 guint		 addr,
+					 guchar		*data,
+					 gsize		 data_length,
+					 gsize		*recieved_length,
+					 LibddcDeviceError *kind,
+					 gpointer	 user_data,
+					 GError		**error);
+	gboolean	(*write)	(LibddcDevice	*device,
+					 guint		 addr,
+					 const guchar	*data,
+					 gsize		 length,
+					 LibddcDeviceError *kind,
+					 gpointer	 user_data,
+					 GError		**error);
+	void		(*close)	(LibddcDevice	*device,
+					 gpointer	 user_data);
+	gboolean	(*transfer)	(LibddcDevice	*device,
+					 LibddcDeviceMessage *msgs,
+					 guint		 n_msgs,
+					 LibddcDeviceError *kind,
+					 gpointer	 user_data,
+					 GError		**error);
+} LibddcDeviceTransport;
+
 /* incest */
 #include <libddc-control.h>
 
@@ -94,37 +259,138 @@ LibddcDevice	*libddc_device_new			(void);
 gboolean	 libddc_device_open			(LibddcDevice	*device,
 							 const gchar	*filename,
 							 GError		**error);
+void		 libddc_device_open_async		(LibddcDevice	*device,
+							 const gchar	*filename,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 libddc_device_open_finish		(LibddcDevice	*device,
+							 GAsyncResult	*res,
+							 GError		**error);
 gboolean	 libddc_device_close			(LibddcDevice	*device,
 							 GError		**error);
 const guint8	*libddc_device_get_edid			(LibddcDevice	*device,
 							 gsize		*length,
 							 GError		**error);
+const guint8	*libddc_device_get_edid_full		(LibddcDevice	*device,
+							 gsize		*length,
+							 guint		*extensions,
+							 GError		**error);
 const gchar	*libddc_device_get_edid_md5		(LibddcDevice	*device,
 							 GError		**error);
 gboolean	 libddc_device_write			(LibddcDevice	*device,
 							 guchar		 *data,
 							 gsize		 length,
 							 GError		**error);
+gboolean	 libddc_device_command			(LibddcDevice	*device,
+							 guchar		*data,
+							 gsize		 length,
+							 guchar		*reply,
+							 gsize		 reply_length,
+							 gsize		*recieved_length,
+							 GError		**error);
+void		 libddc_device_set_retry_policy		(LibddcDevice	*device,
+							 LibddcDeviceError kind,
+							 guint		 retries,
+							 gdouble	 delay);
+void		 libddc_device_get_retry_stats		(LibddcDevice	*device,
+							 LibddcDeviceError kind,
+							 guint		*errors,
+							 guint		*retries);
+void		 libddc_device_get_stats		(LibddcDevice	*device,
+							 LibddcDeviceStatsKind kind,
+							 LibddcDeviceStats *stats);
+void		 libddc_device_reset_stats		(LibddcDevice	*device);
+guint64		 libddc_device_get_stats_bucket_limit	(guint		 bucket);
+const gchar	*libddc_device_stats_kind_to_string	(LibddcDeviceStatsKind kind);
+const gchar	*libddc_device_error_to_string		(LibddcDeviceError error);
+guint		 libddc_device_poll			(LibddcDevice	*device,
+							 LibddcPollItem	*items,
+							 guint		 n_items);
 gboolean	 libddc_device_read			(LibddcDevice	*device,
 							 guchar		*data,
 							 gsize		 data_length,
 							 gsize		*recieved_length,
 							 GError		**error);
+void		 libddc_device_command_async		(LibddcDevice	*device,
+							 const guchar	*data,
+							 gsize		 length,
+							 gsize		 reply_length,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GBytes		*libddc_device_command_finish		(LibddcDevice	*device,
+							 GAsyncResult	*res,
+							 GError		**error);
+void		 libddc_device_set_manual_dispatch	(LibddcDevice	*device,
+							 gboolean	 manual_dispatch);
+gint64		 libddc_device_get_ready_time		(LibddcDevice	*device);
+gboolean	 libddc_device_dispatch			(LibddcDevice	*device);
 gboolean	 libddc_device_save			(LibddcDevice	*device,
 							 GError		**error);
+void		 libddc_device_save_async		(LibddcDevice	*device,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 libddc_device_save_finish		(LibddcDevice	*device,
+							 GAsyncResult	*res,
+							 GError		**error);
+gboolean	 libddc_device_ensure_startup		(LibddcDevice	*device,
+							 GError		**error);
+gboolean	 libddc_device_calibrate		(LibddcDevice	*device,
+							 GError		**error);
+void		 libddc_device_get_delays		(LibddcDevice	*device,
+							 gdouble	*read_delay,
+							 gdouble	*write_delay);
 const gchar	*libddc_device_get_pnpid		(LibddcDevice	*device,
 							 GError		**error);
 const gchar	*libddc_device_get_model		(LibddcDevice	*device,
 							 GError		**error);
+void		 libddc_device_get_caps_stats		(LibddcDevice	*device,
+							 guint		*fragments,
+							 guint		*bytes,
+							 guint		*retries);
+void		 libddc_device_set_use_cache		(LibddcDevice	*device,
+							 gboolean	 use_cache);
+gboolean	 libddc_device_invalidate_cache		(LibddcDevice	*device,
+							 GError		**error);
+gboolean	 libddc_device_set_capabilities		(LibddcDevice	*device,
+							 const gchar	*caps,
+							 GError		**error);
+void		 libddc_device_set_store		(LibddcDevice	*device,
+							 LibddcStore	*store);
+LibddcStore	*libddc_device_get_store		(LibddcDevice	*device);
+void		 libddc_device_set_connector		(LibddcDevice	*device,
+							 const gchar	*connector);
+const gchar	*libddc_device_get_connector		(LibddcDevice	*device);
+void		 libddc_device_set_edid_filename	(LibddcDevice	*device,
+							 const gchar	*filename);
 LibddcDeviceKind libddc_device_get_kind			(LibddcDevice	*device,
 							 GError		**error);
 GPtrArray	*libddc_device_get_controls		(LibddcDevice	*device,
 							 GError		**error);
+void		 libddc_device_get_controls_async	(LibddcDevice	*device,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GPtrArray	*libddc_device_get_controls_finish	(LibddcDevice	*device,
+							 GAsyncResult	*res,
+							 GError		**error);
 LibddcControl	*libddc_device_get_control_by_id	(LibddcDevice	*device,
 							 guchar		 id,
 							 GError		**error);
+LibddcSnapshot	*libddc_device_snapshot			(LibddcDevice	*device,
+							 GError		**error);
+LibddcSnapshot	*libddc_device_reconcile		(LibddcDevice	*device,
+							 LibddcSnapshot	*target,
+							 LibddcDeviceReconcileFlags flags,
+							 GError		**error);
 void		 libddc_device_set_verbose		(LibddcDevice	*device,
 							 LibddcVerbose verbose);
+void		 libddc_device_set_transport		(LibddcDevice	*device,
+							 const LibddcDeviceTransport *transport,
+							 gpointer	 user_data,
+							 GDestroyNotify	 destroy_func);
 
 G_END_DECLS
 
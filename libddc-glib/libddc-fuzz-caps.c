@@ -0,0 +1,139 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Feeds arbitrary capabilities strings to the parser.
+ *
+ * By default this replays the corpus in data/tests, and every truncation
+ * of each string, as part of 'make check'. Build with sanitizers to catch
+ * memory errors, e.g. CFLAGS="-g -fsanitize=address,undefined".
+ *
+ * To fuzz with libFuzzer instead:
+ *   ./configure CC=clang CFLAGS="-g -fsanitize=address,undefined,fuzzer-no-link" \
+ *               --enable-fuzzing --disable-strict
+ *   ./libddc-glib/libddc-fuzz-caps -max_len=4096
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libddc-device.h"
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+static LibddcDevice *libddc_fuzz_device = NULL;
+
+/**
+ * LLVMFuzzerTestOneInput:
+ **/
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+	guint i;
+	gchar *caps;
+	GArray *values;
+	GPtrArray *controls;
+
+	/* parsing again forgets the old controls, so reuse the device */
+	if (libddc_fuzz_device == NULL) {
+		g_type_init ();
+		libddc_fuzz_device = libddc_device_new ();
+	}
+
+	/* the fragments are assembled into a string, so stop at any NUL */
+	caps = g_strndup ((const gchar *) data, size);
+	if (libddc_device_set_capabilities (libddc_fuzz_device, caps, NULL)) {
+		controls = libddc_device_get_controls (libddc_fuzz_device, NULL);
+		for (i=0; controls != NULL && i<controls->len; i++) {
+			values = libddc_control_get_values (g_ptr_array_index (controls, i));
+			g_array_unref (values);
+		}
+		if (controls != NULL)
+			g_ptr_array_unref (controls);
+	}
+	g_free (caps);
+	return 0;
+}
+
+#ifndef LIBDDC_FUZZING
+/**
+ * libddc_fuzz_replay:
+ **/
+static gboolean
+libddc_fuzz_replay (const gchar *filename)
+{
+	gboolean ret;
+	gchar *caps;
+	gchar *data = NULL;
+	gchar *tab;
+	gchar **lines;
+	gsize len;
+	guint i;
+	GError *error = NULL;
+
+	ret = g_file_get_contents (filename, &data, NULL, &error);
+	if (!ret) {
+		g_warning ("failed to load %s: %s", filename, error->message);
+		g_error_free (error);
+		goto out;
+	}
+
+	/* a display can stop sending at any point */
+	lines = g_strsplit (data, "\n", -1);
+	for (i=0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0' || lines[i][0] == '#')
+			continue;
+		tab = strchr (lines[i], '\t');
+		caps = g_strcompress (tab != NULL ? tab + 1 : lines[i]);
+		for (len = strlen (caps) + 1; len > 0; len--)
+			LLVMFuzzerTestOneInput ((const uint8_t *) caps, len - 1);
+		g_free (caps);
+	}
+	g_strfreev (lines);
+out:
+	g_free (data);
+	return ret;
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char **argv)
+{
+	gint i;
+	gboolean ret = TRUE;
+
+	if (argc < 2)
+		ret = libddc_fuzz_replay (TESTDATADIR "/capabilities.txt");
+	for (i=1; i<argc; i++) {
+		if (!libddc_fuzz_replay (argv[i]))
+			ret = FALSE;
+	}
+	if (libddc_fuzz_device != NULL)
+		g_object_unref (libddc_fuzz_device);
+	return ret ? 0 : 1;
+}
+#endif
+
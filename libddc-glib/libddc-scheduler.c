@@ -0,0 +1,300 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-scheduler
+ * @short_description: Drives the queued commands of many devices from one source
+ *
+ * Each display needs a pause after every command, so talking to several
+ * displays one after another wastes most of the time waiting. The
+ * scheduler adds a single main loop source that wakes up when the first
+ * of its devices is ready and sends the next part of every command that
+ * can make progress, so the waits on different buses overlap.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include <libddc-device.h>
+#include <libddc-scheduler.h>
+
+static void     libddc_scheduler_finalize	(GObject     *object);
+
+#define LIBDDC_SCHEDULER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_SCHEDULER, LibddcSchedulerPrivate))
+
+/**
+ * LibddcSchedulerSource:
+ **/
+typedef struct {
+	GSource			 source;
+	LibddcScheduler		*scheduler;
+} LibddcSchedulerSource;
+
+/**
+ * LibddcSchedulerPrivate:
+ *
+ * Private #LibddcScheduler data
+ **/
+struct _LibddcSchedulerPrivate
+{
+	GPtrArray		*devices;
+	GSource			*source;
+};
+
+G_DEFINE_TYPE (LibddcScheduler, libddc_scheduler, G_TYPE_OBJECT)
+
+/**
+ * libddc_scheduler_get_ready_time:
+ *
+ * Return value: the earliest time any device can make progress, or -1
+ **/
+static gint64
+libddc_scheduler_get_ready_time (LibddcScheduler *scheduler)
+{
+	gint64 ready;
+	gint64 ret = -1;
+	guint i;
+	LibddcDevice *device;
+
+	for (i=0; i<scheduler->priv->devices->len; i++) {
+		device = g_ptr_array_index (scheduler->priv->devices, i);
+		ready = libddc_device_get_ready_time (device);
+		if (ready < 0)
+			continue;
+		if (ret < 0 || ready < ret)
+			ret = ready;
+	}
+	return ret;
+}
+
+/**
+ * libddc_scheduler_source_prepare:
+ **/
+static gboolean
+libddc_scheduler_source_prepare (GSource *source, gint *timeout)
+{
+	LibddcScheduler *scheduler = ((LibddcSchedulerSource *) source)->scheduler;
+	gint64 ready;
+	gint64 now;
+
+	ready = libddc_scheduler_get_ready_time (scheduler);
+	if (ready < 0) {
+		*timeout = -1;
+		return FALSE;
+	}
+	now = g_source_get_time (source);
+	if (ready <= now) {
+		*timeout = 0;
+		return TRUE;
+	}
+
+	/* round up so we never wake up just before the deadline */
+	*timeout = (gint) ((ready - now + 999) / 1000);
+	return FALSE;
+}
+
+/**
+ * libddc_scheduler_source_check:
+ **/
+static gboolean
+libddc_scheduler_source_check (GSource *source)
+{
+	LibddcScheduler *scheduler = ((LibddcSchedulerSource *) source)->scheduler;
+	gint64 ready;
+
+	ready = libddc_scheduler_get_ready_time (scheduler);
+	if (ready < 0)
+		return FALSE;
+	return ready <= g_source_get_time (source);
+}
+
+/**
+ * libddc_scheduler_source_dispatch:
+ **/
+static gboolean
+libddc_scheduler_source_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	LibddcScheduler *scheduler = ((LibddcSchedulerSource *) source)->scheduler;
+	GPtrArray *devices;
+	guint i;
+
+	/* completing a command may add or remove devices */
+	devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i=0; i<scheduler->priv->devices->len; i++)
+		g_ptr_array_add (devices, g_object_ref (g_ptr_array_index (scheduler->priv->devices, i)));
+	for (i=0; i<devices->len; i++)
+		libddc_device_dispatch (g_ptr_array_index (devices, i));
+	g_ptr_array_unref (devices);
+	return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs libddc_scheduler_source_funcs = {
+	libddc_scheduler_source_prepare,
+	libddc_scheduler_source_check,
+	libddc_scheduler_source_dispatch,
+	NULL, NULL, NULL
+};
+
+/**
+ * libddc_scheduler_add_device:
+ * @scheduler: a #LibddcScheduler
+ * @device: a #LibddcDevice
+ *
+ * Adds a device to the scheduler. Commands queued with the async device
+ * and control functions are then sent from the scheduler source rather
+ * than from a timeout per device.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_scheduler_add_device (LibddcScheduler *scheduler, LibddcDevice *device)
+{
+	guint i;
+
+	g_return_if_fail (LIBDDC_IS_SCHEDULER(scheduler));
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	for (i=0; i<scheduler->priv->devices->len; i++) {
+		if (g_ptr_array_index (scheduler->priv->devices, i) == device)
+			return;
+	}
+	libddc_device_set_manual_dispatch (device, TRUE);
+	g_ptr_array_add (scheduler->priv->devices, g_object_ref (device));
+
+	/* commands may already be waiting */
+	g_main_context_wakeup (g_source_get_context (scheduler->priv->source));
+}
+
+/**
+ * libddc_scheduler_remove_device:
+ * @scheduler: a #LibddcScheduler
+ * @device: a #LibddcDevice
+ *
+ * Removes a device from the scheduler. Any commands still queued on the
+ * device are then sent using its own timeouts.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_scheduler_remove_device (LibddcScheduler *scheduler, LibddcDevice *device)
+{
+	g_return_if_fail (LIBDDC_IS_SCHEDULER(scheduler));
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	g_object_ref (device);
+	if (g_ptr_array_remove (scheduler->priv->devices, device))
+		libddc_device_set_manual_dispatch (device, FALSE);
+	g_object_unref (device);
+}
+
+/**
+ * libddc_scheduler_get_pending:
+ * @scheduler: a #LibddcScheduler
+ *
+ * Return value: the number of devices that have commands queued
+ *
+ * Since: 0.0.1
+ **/
+guint
+libddc_scheduler_get_pending (LibddcScheduler *scheduler)
+{
+	guint i;
+	guint pending = 0;
+	LibddcDevice *device;
+
+	g_return_val_if_fail (LIBDDC_IS_SCHEDULER(scheduler), 0);
+
+	for (i=0; i<scheduler->priv->devices->len; i++) {
+		device = g_ptr_array_index (scheduler->priv->devices, i);
+		if (libddc_device_get_ready_time (device) >= 0)
+			pending++;
+	}
+	return pending;
+}
+
+/**
+ * libddc_scheduler_class_init:
+ **/
+static void
+libddc_scheduler_class_init (LibddcSchedulerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_scheduler_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcSchedulerPrivate));
+}
+
+/**
+ * libddc_scheduler_init:
+ **/
+static void
+libddc_scheduler_init (LibddcScheduler *scheduler)
+{
+	scheduler->priv = LIBDDC_SCHEDULER_GET_PRIVATE (scheduler);
+	scheduler->priv->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+
+	/* the source does not own the scheduler */
+	scheduler->priv->source = g_source_new (&libddc_scheduler_source_funcs,
+						sizeof (LibddcSchedulerSource));
+	((LibddcSchedulerSource *) scheduler->priv->source)->scheduler = scheduler;
+	g_source_set_name (scheduler->priv->source, "[libddc] scheduler");
+	g_source_attach (scheduler->priv->source, g_main_context_get_thread_default ());
+}
+
+/**
+ * libddc_scheduler_finalize:
+ **/
+static void
+libddc_scheduler_finalize (GObject *object)
+{
+	LibddcScheduler *scheduler = LIBDDC_SCHEDULER (object);
+	LibddcSchedulerPrivate *priv = scheduler->priv;
+	LibddcDevice *device;
+	guint i;
+
+	g_return_if_fail (LIBDDC_IS_SCHEDULER(scheduler));
+
+	g_source_destroy (priv->source);
+	g_source_unref (priv->source);
+	for (i=0; i<priv->devices->len; i++) {
+		device = g_ptr_array_index (priv->devices, i);
+		libddc_device_set_manual_dispatch (device, FALSE);
+	}
+	g_ptr_array_unref (priv->devices);
+
+	G_OBJECT_CLASS (libddc_scheduler_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_scheduler_new:
+ *
+ * Return value: A new %LibddcScheduler instance
+ *
+ * Since: 0.0.1
+ **/
+LibddcScheduler *
+libddc_scheduler_new (void)
+{
+	LibddcScheduler *scheduler;
+	scheduler = g_object_new (LIBDDC_TYPE_SCHEDULER, NULL);
+	return LIBDDC_SCHEDULER (scheduler);
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_SCHEDULER_H
+#define __LIBDDC_SCHEDULER_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+#include <libddc-device.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_SCHEDULER		(libddc_scheduler_get_type ())
+#define LIBDDC_SCHEDULER(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_SCHEDULER, LibddcScheduler))
+#define LIBDDC_SCHEDULER_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_SCHEDULER, LibddcSchedulerClass))
+#define LIBDDC_IS_SCHEDULER(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_SCHEDULER))
+#define LIBDDC_IS_SCHEDULER_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_SCHEDULER))
+#define LIBDDC_SCHEDULER_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_SCHEDULER, LibddcSchedulerClass))
+
+typedef struct _LibddcSchedulerPrivate		LibddcSchedulerPrivate;
+typedef struct _LibddcScheduler			LibddcScheduler;
+typedef struct _LibddcSchedulerClass		LibddcSchedulerClass;
+
+struct _LibddcScheduler
+{
+	 GObject		 parent;
+	 LibddcSchedulerPrivate	*priv;
+};
+
+struct _LibddcSchedulerClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GType		 libddc_scheduler_get_type		(void);
+LibddcScheduler	*libddc_scheduler_new			(void);
+
+void		 libddc_scheduler_add_device		(LibddcScheduler *scheduler,
+							 LibddcDevice	*device);
+void		 libddc_scheduler_remove_device		(LibddcScheduler *scheduler,
+							 LibddcDevice	*device);
+guint		 libddc_scheduler_get_pending		(LibddcScheduler *scheduler);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_SCHEDULER_H */
+
@@ -22,9 +22,17 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "libddc-batch.h"
 #include "libddc-client.h"
 #include "libddc-device.h"
+#include "libddc-scheduler.h"
+#include "libddc-simulator.h"
+#include "libddc-store.h"
+#include "libddc-watcher.h"
 
 static void
 libddc_test_device_func (void)
@@ -48,16 +56,1679 @@ libddc_test_client_func (void)
 	g_object_unref (client);
 }
 
+static void
+libddc_test_simulator_func (void)
+{
+	gboolean ret;
+	guint16 value, maximum;
+	const gchar *pnpid;
+	GPtrArray *controls;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+
+	/* open */
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* get EDID */
+	pnpid = libddc_device_get_pnpid (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (pnpid, ==, "SIM0001");
+
+	/* get capabilities */
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert (controls != NULL);
+	g_assert_cmpint (controls->len, ==, 14);
+	g_ptr_array_unref (controls);
+	g_assert_cmpstr (libddc_device_get_model (device, NULL), ==, "LIBDDC SIMULATOR");
+
+	/* get brightness */
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	g_assert (control != NULL);
+	ret = libddc_control_request (control, &value, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+	g_assert_cmpint (maximum, ==, 100);
+
+	/* set brightness */
+	ret = libddc_control_set (control, 30, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (value, ==, 30);
+
+	/* reset brightness */
+	ret = libddc_control_reset (control, &error);
+	g_assert_no_error (error);
+	libddc_simulator_get_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert_cmpint (value, ==, 80);
+
+	/* a reset is not answered from the cache */
+	libddc_control_set_max_age (control, 60000);
+	ret = libddc_control_set (control, 30, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_control_reset (control, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_calibrate_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	gdouble read_delay, write_delay, tmp;
+	GError *error = NULL;
+	GTimer *timer;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	/* the display needs 10ms to prepare a reply */
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_latency (simulator, 10000);
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* find the fastest safe delays */
+	ret = libddc_device_calibrate (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	libddc_device_get_delays (device, &read_delay, &write_delay);
+	g_assert_cmpfloat (write_delay, >, 0.010f);
+	g_assert_cmpfloat (write_delay, <, 0.050f);
+	g_assert_cmpfloat (read_delay, <, 0.040f);
+
+	/* the EEPROM write does not get any faster */
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	ret = libddc_device_save (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	timer = g_timer_new ();
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), >, 0.150f);
+	g_timer_destroy (timer);
+	g_object_unref (control);
+	g_object_unref (device);
+
+	/* the timings are used once the display is used again */
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (libddc_device_get_edid_md5 (device, NULL) != NULL);
+	libddc_device_get_delays (device, NULL, &tmp);
+	g_assert_cmpfloat (tmp, ==, write_delay);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_edid_func (void)
+{
+	gboolean ret;
+	guint i;
+	guint extensions;
+	gsize length;
+	guint8 data[4 * 128];
+	const guint8 *edid;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcDeviceStats stats;
+	LibddcSimulator *simulator;
+	static const guint8 header[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+	/* base block with three extensions, each block tagged with its index */
+	for (i=0; i<sizeof (data); i++)
+		data[i] = i / 128;
+	memcpy (data, header, sizeof (header));
+	data[126] = 3;
+
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_edid (simulator, data, sizeof (data));
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* get all the blocks */
+	edid = libddc_device_get_edid_full (device, &length, &extensions, &error);
+	g_assert_no_error (error);
+	g_assert (edid != NULL);
+	g_assert_cmpint (extensions, ==, 3);
+	g_assert_cmpint (length, ==, sizeof (data));
+	g_assert (memcmp (edid, data, sizeof (data)) == 0);
+	g_object_unref (device);
+	g_object_unref (simulator);
+
+	/* only the base block is read when there are no extensions */
+	data[126] = 0;
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_edid (simulator, data, 128);
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	edid = libddc_device_get_edid (device, &length, &error);
+	g_assert_no_error (error);
+	g_assert (edid != NULL);
+	g_assert_cmpint (length, ==, 128);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_EDID, &stats);
+	g_assert_cmpint (stats.transactions, ==, 1);
+	g_assert_cmpint (stats.bytes_read, ==, 128);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_edid_sysfs_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	const gchar *pnpid;
+	guint8 data[128];
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	static const guint8 header[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+	/* the display itself returns garbage */
+	memset (data, 0xaa, sizeof (data));
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_edid (simulator, data, sizeof (data));
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* but the kernel copy is fine, 'ACR' 0x1234 */
+	memset (data, 0, sizeof (data));
+	memcpy (data, header, sizeof (header));
+	data[8] = 0x04;
+	data[9] = 0x72;
+	data[10] = 0x34;
+	data[11] = 0x12;
+	filename = g_build_filename (g_get_user_cache_dir (), "edid", NULL);
+	g_mkdir_with_parents (g_get_user_cache_dir (), 0755);
+	ret = g_file_set_contents (filename, (const gchar *) data, sizeof (data), &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	libddc_device_set_edid_filename (device, filename);
+
+	pnpid = libddc_device_get_pnpid (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (pnpid, ==, "ACR1234");
+
+	g_unlink (filename);
+	g_free (filename);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_caps_cache_func (void)
+{
+	gboolean ret;
+	GPtrArray *controls;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	/* read from the display and save */
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 14);
+	g_ptr_array_unref (controls);
+	g_object_unref (device);
+
+	/* the display now says something different, but is not asked */
+	libddc_simulator_set_caps (simulator, "(prot(monitor)type(lcd)model(NEW)vcp(10 12))");
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 14);
+	g_ptr_array_unref (controls);
+
+	/* until the cache is invalidated */
+	ret = libddc_device_invalidate_cache (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 2);
+	g_ptr_array_unref (controls);
+	g_assert_cmpstr (libddc_device_get_model (device, NULL), ==, "NEW");
+
+	/* nothing parsed from the old string is kept */
+	libddc_simulator_set_caps (simulator, "(prot(monitor)vcp(10))");
+	ret = libddc_device_invalidate_cache (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (libddc_device_get_model (device, NULL), ==, NULL);
+	g_assert_cmpint (libddc_device_get_kind (device, NULL), ==, LIBDDC_DEVICE_KIND_UNKNOWN);
+	g_object_unref (device);
+
+	/* or bypassed */
+	libddc_simulator_set_caps (simulator, "(prot(monitor)type(lcd)model(NEWER)vcp(10))");
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	libddc_device_set_use_cache (device, FALSE);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 1);
+	g_ptr_array_unref (controls);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+#define LIBDDC_TEST_STORE_MD5		"0123456789abcdef0123456789abcdef"
+
+static gpointer
+libddc_test_store_thread_cb (gpointer user_data)
+{
+	guint16 i;
+	LibddcStore *store = LIBDDC_STORE (user_data);
+
+	/* value and maximum are always written as a pair */
+	for (i=0; i<10000; i++)
+		libddc_store_update (store, LIBDDC_TEST_STORE_MD5, 0x12, i, i);
+	return NULL;
+}
+
+static void
+libddc_test_store_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	gint64 timestamp;
+	guint16 value, maximum;
+	guint i;
+	GError *error = NULL;
+	GThread *threads[4];
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcStore *reader;
+	LibddcStore *writer;
+
+	/* two mappings of the same file, as if in two processes */
+	filename = g_build_filename (g_get_user_cache_dir (), "state", NULL);
+	g_unlink (filename);
+	writer = libddc_store_new ();
+	ret = libddc_store_open (writer, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	reader = libddc_store_new ();
+	ret = libddc_store_open (reader, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* requests and sets are recorded */
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	libddc_device_set_store (device, writer);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	ret = libddc_control_request (control, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_control_set (control, 33, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_store_lookup (reader, libddc_device_get_edid_md5 (device, NULL),
+				   LIBDDC_CONTROL_ID_BRIGHTNESS, &value, &maximum, &timestamp);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 33);
+	g_assert_cmpint (maximum, ==, 100);
+	g_assert_cmpint (timestamp, <=, g_get_real_time ());
+
+	/* concurrent writers never leave a torn slot */
+	for (i=0; i<G_N_ELEMENTS(threads); i++)
+		threads[i] = g_thread_new ("writer", libddc_test_store_thread_cb, writer);
+	for (i=0; i<10000; i++) {
+		if (!libddc_store_lookup (reader, LIBDDC_TEST_STORE_MD5, 0x12, &value, &maximum, NULL))
+			continue;
+		g_assert_cmpint (value, ==, maximum);
+	}
+	for (i=0; i<G_N_ELEMENTS(threads); i++)
+		g_thread_join (threads[i]);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+	g_object_unref (reader);
+	g_object_unref (writer);
+}
+
+static void
+libddc_test_caps_retry_func (void)
+{
+	gboolean ret;
+	guint fragments, bytes, retries;
+	GPtrArray *controls;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	/* the display loses a few replies */
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_failures (simulator, 3);
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	libddc_device_set_use_cache (device, FALSE);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 14);
+	g_ptr_array_unref (controls);
+
+	/* the simulator sends 32 bytes at a time */
+	libddc_device_get_caps_stats (device, &fragments, &bytes, &retries);
+	g_assert_cmpint (retries, ==, 3);
+	g_assert_cmpint (fragments, ==, (bytes + 31) / 32);
+	g_test_message ("%u bytes in %u fragments with %u retries", bytes, fragments, retries);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_caps_corpus_func (void)
+{
+	gboolean ret;
+	gchar *caps;
+	gchar *data = NULL;
+	gchar *tab;
+	gchar **lines;
+	guint i;
+	GArray *values;
+	GPtrArray *controls;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device;
+
+	ret = g_file_get_contents (TESTDATADIR "/capabilities.txt", &data, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* each line has the number of controls we expect */
+	device = libddc_device_new ();
+	lines = g_strsplit (data, "\n", -1);
+	for (i=0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0' || lines[i][0] == '#')
+			continue;
+		tab = strchr (lines[i], '\t');
+		g_assert (tab != NULL);
+		caps = g_strcompress (tab + 1);
+		ret = libddc_device_set_capabilities (device, caps, &error);
+		if (lines[i][0] == '-') {
+			g_assert_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED);
+			g_assert (!ret);
+			g_clear_error (&error);
+		} else {
+			g_assert_no_error (error);
+			g_assert (ret);
+			controls = libddc_device_get_controls (device, &error);
+			g_assert_no_error (error);
+			g_assert_cmpint (controls->len, ==, atoi (lines[i]));
+			g_ptr_array_unref (controls);
+		}
+		g_free (caps);
+	}
+
+	/* the allowed values are hex too */
+	ret = libddc_device_set_capabilities (device, "(vcp(14(05 06 0b) 60(0F 11)))", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, 0x14, &error);
+	g_assert_no_error (error);
+	values = libddc_control_get_values (control);
+	g_assert_cmpint (values->len, ==, 3);
+	g_assert_cmpint (g_array_index (values, guint16, 2), ==, 0x0b);
+	g_array_unref (values);
+	g_object_unref (control);
+	control = libddc_device_get_control_by_id (device, 0x60, &error);
+	g_assert_no_error (error);
+	values = libddc_control_get_values (control);
+	g_assert_cmpint (values->len, ==, 2);
+	g_assert_cmpint (g_array_index (values, guint16, 0), ==, 0x0f);
+	g_array_unref (values);
+	g_object_unref (control);
+
+	g_strfreev (lines);
+	g_free (data);
+	g_object_unref (device);
+}
+
+#ifdef __GLIBC__
+/* count the allocations made while a test is watching */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+static volatile gint libddc_test_allocs = 0;
+static volatile gboolean libddc_test_counting = FALSE;
+
+void *
+malloc (size_t size)
+{
+	if (libddc_test_counting)
+		g_atomic_int_inc (&libddc_test_allocs);
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	if (libddc_test_counting)
+		g_atomic_int_inc (&libddc_test_allocs);
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	if (libddc_test_counting)
+		g_atomic_int_inc (&libddc_test_allocs);
+	return __libc_realloc (ptr, size);
+}
+
+static void
+libddc_test_poll_func (void)
+{
+	gboolean ret;
+	gchar *tmp;
+	guint i;
+	guint ok = 0;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcPollItem items[] = {
+		{ LIBDDC_CONTROL_ID_BRIGHTNESS, 0, 0, LIBDDC_POLL_STATUS_OK },
+		{ 0x12, 0, 0, LIBDDC_POLL_STATUS_OK },
+		{ 0x6c, 0, 0, LIBDDC_POLL_STATUS_OK } };
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* make the loop quick, and do the one-off startup */
+	ret = libddc_device_calibrate (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	libddc_device_poll (device, items, G_N_ELEMENTS (items));
+
+	/* check the counting works at all */
+	libddc_test_allocs = 0;
+	libddc_test_counting = TRUE;
+	tmp = g_strdup ("counted");
+	libddc_test_counting = FALSE;
+	g_free (tmp);
+	g_assert_cmpint (libddc_test_allocs, >, 0);
+
+	/* the steady state, including an unsupported control */
+	libddc_test_allocs = 0;
+	libddc_test_counting = TRUE;
+	for (i=0; i<20; i++)
+		ok += libddc_device_poll (device, items, G_N_ELEMENTS (items));
+	libddc_test_counting = FALSE;
+	g_assert_cmpint (libddc_test_allocs, ==, 0);
+	g_assert_cmpint (ok, ==, 40);
+	g_assert_cmpint (items[0].status, ==, LIBDDC_POLL_STATUS_OK);
+	g_assert_cmpint (items[0].value, ==, 80);
+	g_assert_cmpint (items[0].maximum, ==, 100);
+	g_assert_cmpint (items[1].status, ==, LIBDDC_POLL_STATUS_OK);
+	g_assert_cmpint (items[1].value, ==, 50);
+	g_assert_cmpint (items[2].status, ==, LIBDDC_POLL_STATUS_UNSUPPORTED);
+
+	/* a lost reply is retried without allocating */
+	ok = 0;
+	libddc_test_allocs = 0;
+	libddc_test_counting = TRUE;
+	for (i=0; i<5; i++) {
+		libddc_simulator_set_failures (simulator, 1);
+		ok += libddc_device_poll (device, items, G_N_ELEMENTS (items));
+	}
+	libddc_test_counting = FALSE;
+	g_assert_cmpint (libddc_test_allocs, ==, 0);
+	g_assert_cmpint (ok, ==, 10);
+	g_assert_cmpint (items[0].status, ==, LIBDDC_POLL_STATUS_OK);
+	g_assert_cmpint (items[0].value, ==, 80);
+
+	/* and so is giving up on it */
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_NULL_MESSAGE, 0, 0);
+	ok = 0;
+	libddc_test_allocs = 0;
+	libddc_test_counting = TRUE;
+	for (i=0; i<5; i++) {
+		libddc_simulator_set_failures (simulator, 1);
+		ok += libddc_device_poll (device, items, G_N_ELEMENTS (items));
+	}
+	libddc_test_counting = FALSE;
+	g_assert_cmpint (libddc_test_allocs, ==, 0);
+	g_assert_cmpint (ok, ==, 5);
+	g_assert_cmpint (items[0].status, ==, LIBDDC_POLL_STATUS_INVALID_REPLY);
+	g_assert_cmpint (items[1].status, ==, LIBDDC_POLL_STATUS_OK);
+	g_assert_cmpint (items[1].value, ==, 50);
+	g_assert_cmpint (items[2].status, ==, LIBDDC_POLL_STATUS_UNSUPPORTED);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+#endif
+
+static void
+libddc_test_lazy_func (void)
+{
+	gboolean ret;
+	const gchar *pnpid;
+	guint8 data[128];
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	/* a display that returns garbage for the EDID */
+	memset (data, 0xaa, sizeof (data));
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_edid (simulator, data, sizeof (data));
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+
+	/* opening does not talk to the display */
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* but the first use does */
+	pnpid = libddc_device_get_pnpid (device, &error);
+	g_assert (error != NULL);
+	g_assert (pnpid == NULL);
+	g_clear_error (&error);
+
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_deadline_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	GTimer *timer;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+
+	/* a set returns as soon as the frame is sent */
+	g_usleep (100000);
+	timer = g_timer_new ();
+	ret = libddc_control_set (control, 20, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 0.02f);
+
+	/* but the next command still waits for the display */
+	g_timer_reset (timer);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (value, ==, 20);
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), >=, 0.05f);
+
+	g_timer_destroy (timer);
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_async_set_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	ret = libddc_control_set_finish (LIBDDC_CONTROL (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static void
+libddc_test_async_request_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	guint16 value, maximum;
+	GError *error = NULL;
+
+	ret = libddc_control_request_finish (LIBDDC_CONTROL (source), res, &value, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 42);
+	g_assert_cmpint (maximum, ==, 100);
+	g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+libddc_test_async_open_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device = LIBDDC_DEVICE (source);
+
+	ret = libddc_device_open_finish (device, res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* both are queued, and sent in order */
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	libddc_control_set_async (control, 42, NULL, libddc_test_async_set_cb, NULL);
+	libddc_control_request_async (control, NULL, libddc_test_async_request_cb, user_data);
+	g_object_unref (control);
+}
+
+static void
+libddc_test_async_func (void)
+{
+	GMainLoop *loop;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	libddc_device_open_async (device, "simulator", NULL, libddc_test_async_open_cb, loop);
+	g_main_loop_run (loop);
+
+	g_main_loop_unref (loop);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_async_startup_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	ret = libddc_control_set_finish (LIBDDC_CONTROL (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+libddc_test_async_startup_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	GMainLoop *loop;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcDeviceStats stats;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_caps (simulator, "(prot(monitor)type(lcd)model(STARTUP)vcp(10 F7))");
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+
+	/* the presence command goes before the first async command only */
+	loop = g_main_loop_new (NULL, FALSE);
+	libddc_control_set_async (control, 42, NULL, libddc_test_async_startup_cb, loop);
+	g_main_loop_run (loop);
+	libddc_control_set_async (control, 43, NULL, libddc_test_async_startup_cb, loop);
+	g_main_loop_run (loop);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_OTHER, &stats);
+	g_assert_cmpint (stats.transactions, ==, 1);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_SET, &stats);
+	g_assert_cmpint (stats.transactions, ==, 2);
+
+	g_main_loop_unref (loop);
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+#define LIBDDC_TEST_SHARED_CAPS		"(prot(monitor)type(lcd)model(SHARED)vcp(10 12 16))"
+
+typedef struct {
+	GMainLoop		*loop;
+	guint			 remaining;
+} LibddcTestControlsHelper;
+
+static void
+libddc_test_controls_async_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	GPtrArray *controls;
+	LibddcTestControlsHelper *helper = (LibddcTestControlsHelper *) user_data;
+
+	controls = libddc_device_get_controls_finish (LIBDDC_DEVICE (source), res, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 3);
+	g_ptr_array_unref (controls);
+	if (--helper->remaining == 0)
+		g_main_loop_quit (helper->loop);
+}
+
+static void
+libddc_test_controls_async_func (void)
+{
+	gboolean ret;
+	guint fragments, bytes, retries;
+	GError *error = NULL;
+	GPtrArray *controls;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcTestControlsHelper helper;
+
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_caps (simulator, LIBDDC_TEST_SHARED_CAPS);
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	libddc_device_set_use_cache (device, FALSE);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the second caller shares the first fetch, which retries lost
+	 * fragments the same way as the sync fetch */
+	libddc_simulator_set_failures (simulator, 2);
+	helper.loop = g_main_loop_new (NULL, FALSE);
+	helper.remaining = 2;
+	libddc_device_get_controls_async (device, NULL, libddc_test_controls_async_cb, &helper);
+	libddc_device_get_controls_async (device, NULL, libddc_test_controls_async_cb, &helper);
+	g_main_loop_run (helper.loop);
+
+	/* so the capabilities were only read and parsed once */
+	controls = libddc_device_get_controls (device, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (controls->len, ==, 3);
+	g_ptr_array_unref (controls);
+	libddc_device_get_caps_stats (device, &fragments, &bytes, &retries);
+	g_assert_cmpint (bytes, ==, strlen (LIBDDC_TEST_SHARED_CAPS));
+	g_assert_cmpint (retries, ==, 2);
+
+	g_main_loop_unref (helper.loop);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_stream_flush_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	ret = libddc_control_stream_flush_finish (LIBDDC_CONTROL (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+libddc_test_stream_cancelled_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	ret = libddc_control_stream_flush_finish (LIBDDC_CONTROL (source), res, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert (!ret);
+	g_error_free (error);
+	g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+libddc_test_stream_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	guint i;
+	GCancellable *cancellable;
+	GError *error = NULL;
+	GMainLoop *loop;
+	GTimer *timer;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+
+	/* a fast drag only sends a few frames, the last being the latest */
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+	for (i=0; i<=100; i++) {
+		ret = libddc_control_stream_push (control, i, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 0.05f);
+	libddc_control_stream_flush_async (control, NULL, libddc_test_stream_flush_cb, loop);
+	g_main_loop_run (loop);
+	g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 0.5f);
+	ret = libddc_simulator_get_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 100);
+
+	/* giving up on a flush still sends the value */
+	ret = libddc_control_stream_push (control, 50, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cancellable = g_cancellable_new ();
+	libddc_control_stream_flush_async (control, cancellable, libddc_test_stream_cancelled_cb, loop);
+	g_cancellable_cancel (cancellable);
+	g_main_loop_run (loop);
+	libddc_control_stream_flush_async (control, NULL, libddc_test_stream_flush_cb, loop);
+	g_main_loop_run (loop);
+	ret = libddc_simulator_get_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 50);
+	g_object_unref (cancellable);
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_cache_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	guint16 maximum;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+
+	/* the first read always goes to the display */
+	libddc_control_set_max_age (control, 60000);
+	ret = libddc_control_request (control, &value, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+	g_assert_cmpint (maximum, ==, 100);
+
+	/* a fresh value is remembered, unless forced */
+	libddc_simulator_set_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 30, 100);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+	ret = libddc_control_request_full (control, LIBDDC_CONTROL_REQUEST_FLAG_FORCE,
+					   &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 30);
+
+	/* the display clamps what is written to its maximum */
+	ret = libddc_control_set (control, 120, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 100);
+
+	/* writing the value updates what we remember */
+	ret = libddc_control_set (control, 40, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	libddc_simulator_set_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 45, 50);
+	ret = libddc_control_request (control, &value, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 40);
+	g_assert_cmpint (maximum, ==, 100);
+
+	/* with no max-age the value is always read, refreshing the maximum */
+	libddc_control_set_max_age (control, 0);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 45);
+	ret = libddc_control_request (control, NULL, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (maximum, ==, 50);
+	libddc_simulator_set_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 45, 60);
+	ret = libddc_control_request (control, NULL, &maximum, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (maximum, ==, 60);
+
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_watcher_changed_cb (LibddcControl *control, guint value, guint *result)
+{
+	*result = value;
+}
+
+static void
+libddc_test_watcher_func (void)
+{
+	gboolean ret;
+	guint changed;
+	guint brightness = 0;
+	guint contrast = 0;
+	GError *error = NULL;
+	LibddcControl *control_brightness;
+	LibddcControl *control_contrast;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcWatcher *watcher;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control_brightness = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	control_contrast = libddc_device_get_control_by_id (device, 0x12, &error);
+	g_assert_no_error (error);
+	g_signal_connect (control_brightness, "changed",
+			  G_CALLBACK (libddc_test_watcher_changed_cb), &brightness);
+	g_signal_connect (control_contrast, "changed",
+			  G_CALLBACK (libddc_test_watcher_changed_cb), &contrast);
+
+	/* nothing changed */
+	watcher = libddc_watcher_new (device);
+	ret = libddc_watcher_check (watcher, &changed, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (changed, ==, 0);
+
+	/* use the front panel buttons */
+	libddc_simulator_change_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 20);
+	libddc_simulator_change_vcp (simulator, 0x12, 70);
+	libddc_simulator_change_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 25);
+	ret = libddc_watcher_check (watcher, &changed, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (changed, ==, 2);
+	g_assert_cmpint (brightness, ==, 25);
+	g_assert_cmpint (contrast, ==, 70);
+
+	/* the FIFO was drained */
+	ret = libddc_watcher_check (watcher, &changed, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (changed, ==, 0);
+
+	/* the same again from the main loop */
+	libddc_simulator_change_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, 35);
+	libddc_watcher_set_interval (watcher, 10);
+	libddc_watcher_start (watcher);
+	while (brightness != 35)
+		g_main_context_iteration (NULL, TRUE);
+	libddc_watcher_stop (watcher);
+	while (libddc_device_get_ready_time (device) != -1)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_object_unref (watcher);
+	g_object_unref (control_brightness);
+	g_object_unref (control_contrast);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_snapshot_func (void)
+{
+	gboolean ret;
+	gchar *data;
+	gsize length;
+	guint16 value;
+	guint16 maximum;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcSnapshot *snapshot;
+	LibddcSnapshot *snapshot_copy;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* only the settings are read, not the actions */
+	snapshot = libddc_device_snapshot (device, &error);
+	g_assert_no_error (error);
+	g_assert (snapshot != NULL);
+	g_assert_cmpint (libddc_snapshot_get_entries (snapshot)->len, ==, 10);
+	g_assert_cmpint (libddc_snapshot_get_failed (snapshot), ==, 0);
+	g_assert_cmpfloat (libddc_snapshot_get_elapsed (snapshot), >, 0.0f);
+	g_assert (!libddc_snapshot_lookup (snapshot, 0x04, NULL, NULL));
+	g_assert (!libddc_snapshot_lookup (snapshot, 0x05, NULL, NULL));
+	ret = libddc_snapshot_lookup (snapshot, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, &maximum);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+	g_assert_cmpint (maximum, ==, 100);
+
+	/* save and load it again */
+	data = libddc_snapshot_to_data (snapshot, &length);
+	g_assert (data != NULL);
+	snapshot_copy = libddc_snapshot_new ();
+	ret = libddc_snapshot_from_data (snapshot_copy, data, length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (libddc_snapshot_get_edid_md5 (snapshot_copy), ==,
+			 libddc_snapshot_get_edid_md5 (snapshot));
+	g_assert_cmpint (libddc_snapshot_get_entries (snapshot_copy)->len, ==, 10);
+	ret = libddc_snapshot_lookup (snapshot_copy, 0x60, &value, &maximum);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 3);
+	g_assert_cmpint (maximum, ==, 4);
+
+	/* garbage is rejected */
+	ret = libddc_snapshot_from_data (snapshot_copy, "[Snapshot]\n[Controls]\nZZ=1;2;\n", -1, &error);
+	g_assert_error (error, LIBDDC_SNAPSHOT_ERROR, LIBDDC_SNAPSHOT_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	g_free (data);
+	g_object_unref (snapshot_copy);
+	g_object_unref (snapshot);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_reconcile_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	GError *error = NULL;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+	LibddcSnapshot *changed;
+	LibddcSnapshot *target;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* already in the desired state */
+	target = libddc_device_snapshot (device, &error);
+	g_assert_no_error (error);
+	g_assert (target != NULL);
+	changed = libddc_device_reconcile (device, target, LIBDDC_DEVICE_RECONCILE_FLAG_SAVE, &error);
+	g_assert_no_error (error);
+	g_assert (changed != NULL);
+	g_assert_cmpint (libddc_snapshot_get_entries (changed)->len, ==, 0);
+	g_object_unref (changed);
+
+	/* only the control that differs is written */
+	libddc_snapshot_add (target, LIBDDC_CONTROL_ID_BRIGHTNESS, 30, 100);
+	changed = libddc_device_reconcile (device, target,
+					   LIBDDC_DEVICE_RECONCILE_FLAG_FORCE_READ |
+					   LIBDDC_DEVICE_RECONCILE_FLAG_SAVE, &error);
+	g_assert_no_error (error);
+	g_assert (changed != NULL);
+	g_assert_cmpint (libddc_snapshot_get_entries (changed)->len, ==, 1);
+	g_assert_cmpint (libddc_snapshot_get_failed (changed), ==, 0);
+	ret = libddc_snapshot_lookup (changed, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 30);
+	libddc_simulator_get_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert_cmpint (value, ==, 30);
+	g_object_unref (changed);
+
+	/* an unknown control means nothing is written */
+	libddc_snapshot_add (target, LIBDDC_CONTROL_ID_BRIGHTNESS, 60, 100);
+	libddc_snapshot_add (target, 0x99, 1, 1);
+	changed = libddc_device_reconcile (device, target, LIBDDC_DEVICE_RECONCILE_FLAG_NONE, &error);
+	g_assert_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED);
+	g_assert (changed == NULL);
+	g_clear_error (&error);
+	libddc_simulator_get_vcp (simulator, LIBDDC_CONTROL_ID_BRIGHTNESS, &value, NULL);
+	g_assert_cmpint (value, ==, 30);
+
+	/* never apply settings meant for another display */
+	libddc_snapshot_set_edid_md5 (target, "00000000000000000000000000000000");
+	changed = libddc_device_reconcile (device, target, LIBDDC_DEVICE_RECONCILE_FLAG_NONE, &error);
+	g_assert_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED);
+	g_assert (changed == NULL);
+	g_clear_error (&error);
+
+	g_object_unref (target);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+#define LIBDDC_TEST_TABLE_ID		0x73
+#define LIBDDC_TEST_TABLE_SIZE		300
+
+static void
+libddc_test_table_func (void)
+{
+	const guint8 *table;
+	gboolean ret;
+	gsize len;
+	guchar data[LIBDDC_TEST_TABLE_SIZE];
+	guchar buf[512];
+	guint i;
+	GError *error = NULL;
+	GInputStream *stream;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	for (i=0; i<sizeof(data); i++)
+		data[i] = i * 7;
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_caps (simulator, "(prot(monitor)type(lcd)model(LIBDDC SIMULATOR)"
+				   "cmds(01 02 03 0C E2 E7 F3)vcp(10 73)mccs_ver(2.1))");
+	libddc_simulator_set_table (simulator, LIBDDC_TEST_TABLE_ID, data, sizeof(data));
+	device = libddc_device_new ();
+	libddc_device_set_use_cache (device, FALSE);
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = libddc_device_calibrate (device, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_TEST_TABLE_ID, &error);
+	g_assert_no_error (error);
+
+	/* read in fragments, surviving a lost reply */
+	libddc_simulator_set_failures (simulator, 1);
+	ret = libddc_control_table_read (control, buf, sizeof(buf), &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, ==, sizeof(data));
+	g_assert (memcmp (buf, data, sizeof(data)) == 0);
+
+	/* too small a buffer */
+	ret = libddc_control_table_read (control, buf, 100, &len, &error);
+	g_assert_error (error, LIBDDC_CONTROL_ERROR, LIBDDC_CONTROL_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* write from a buffer */
+	libddc_simulator_set_table (simulator, LIBDDC_TEST_TABLE_ID, NULL, 0);
+	ret = libddc_control_table_write (control, data, sizeof(data), &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	table = libddc_simulator_get_table (simulator, LIBDDC_TEST_TABLE_ID, &len);
+	g_assert_cmpint (len, ==, sizeof(data));
+	g_assert (memcmp (table, data, sizeof(data)) == 0);
+
+	/* write from a stream that does not end on a fragment */
+	libddc_simulator_set_table (simulator, LIBDDC_TEST_TABLE_ID, NULL, 0);
+	stream = g_memory_input_stream_new_from_data (data, 77, NULL);
+	ret = libddc_control_table_write_stream (control, stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	table = libddc_simulator_get_table (simulator, LIBDDC_TEST_TABLE_ID, &len);
+	g_assert_cmpint (len, ==, 77);
+	g_assert (memcmp (table, data, 77) == 0);
+
+	g_object_unref (stream);
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_retry_func (void)
+{
+	gboolean ret;
+	guint errors;
+	guint retries;
+	guint16 value;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+
+	/* a display that is not ready is asked again */
+	libddc_simulator_set_failures (simulator, 2);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (value, ==, 80);
+	libddc_device_get_retry_stats (device, LIBDDC_DEVICE_ERROR_NULL_MESSAGE, &errors, &retries);
+	g_assert_cmpint (errors, ==, 2);
+	g_assert_cmpint (retries, ==, 2);
+
+	/* unless the policy says not to */
+	libddc_device_set_retry_policy (device, LIBDDC_DEVICE_ERROR_NULL_MESSAGE, 0, 0.0f);
+	libddc_simulator_set_failures (simulator, 1);
+	ret = libddc_control_request (control, &value, NULL, &error);
+	g_assert_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_NULL_MESSAGE);
+	g_assert (!ret);
+	g_clear_error (&error);
+	libddc_device_get_retry_stats (device, LIBDDC_DEVICE_ERROR_NULL_MESSAGE, &errors, &retries);
+	g_assert_cmpint (errors, ==, 3);
+	g_assert_cmpint (retries, ==, 2);
+	libddc_device_get_retry_stats (device, LIBDDC_DEVICE_ERROR_NACK, &errors, &retries);
+	g_assert_cmpint (errors, ==, 0);
+	g_assert_cmpstr (libddc_device_error_to_string (LIBDDC_DEVICE_ERROR_NULL_MESSAGE), ==, "null-message");
+
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static void
+libddc_test_stats_request_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	ret = libddc_control_request_finish (LIBDDC_CONTROL (source), res, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+libddc_test_stats_func (void)
+{
+	gboolean ret;
+	guint16 value;
+	guint i;
+	guint sum;
+	const gchar *md5;
+	GError *error = NULL;
+	GMainLoop *loop;
+	LibddcControl *control;
+	LibddcDevice *device;
+	LibddcDeviceStats stats;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the EDID is read in one bus transaction */
+	md5 = libddc_device_get_edid_md5 (device, &error);
+	g_assert_no_error (error);
+	g_assert (md5 != NULL);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_EDID, &stats);
+	g_assert_cmpint (stats.transactions, >=, 1);
+	g_assert_cmpint (stats.bytes_read, >=, 128);
+
+	/* getting the control fetches the capabilities */
+	control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
+	g_assert_no_error (error);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_CAPABILITIES, &stats);
+	g_assert_cmpint (stats.transactions, >=, 1);
+	g_assert_cmpint (stats.bytes_read, >, 0);
+
+	/* each request is one command and one reply */
+	libddc_device_reset_stats (device);
+	for (i=0; i<3; i++) {
+		ret = libddc_control_request (control, &value, NULL, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_GET, &stats);
+	g_assert_cmpint (stats.transactions, ==, 3);
+	g_assert_cmpint (stats.bytes_written, ==, 3 * 5);
+	g_assert_cmpint (stats.bytes_read, >=, 3 * 11);
+
+	/* every transfer lands in one bucket, and so does every real wait;
+	 * each reply has to wait but a request only if the display is busy */
+	for (i=0, sum=0; i<LIBDDC_DEVICE_STATS_BUCKETS; i++)
+		sum += stats.sleep_histogram[i];
+	g_assert_cmpint (sum, >=, 3);
+	g_assert_cmpint (sum, <=, 6);
+	for (i=0, sum=0; i<LIBDDC_DEVICE_STATS_BUCKETS; i++)
+		sum += stats.bus_histogram[i];
+	g_assert_cmpint (sum, ==, 6);
+	g_assert_cmpint (libddc_device_get_stats_bucket_limit (LIBDDC_DEVICE_STATS_BUCKETS - 1), ==, G_MAXUINT64);
+
+	/* a set is counted separately */
+	ret = libddc_control_set (control, 50, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_SET, &stats);
+	g_assert_cmpint (stats.transactions, ==, 1);
+	g_assert_cmpint (stats.bytes_read, ==, 0);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_GET, &stats);
+	g_assert_cmpint (stats.transactions, ==, 3);
+
+	/* waiting in the main loop counts as sleeping too */
+	libddc_device_reset_stats (device);
+	loop = g_main_loop_new (NULL, FALSE);
+	libddc_control_request_async (control, NULL, libddc_test_stats_request_cb, loop);
+	g_main_loop_run (loop);
+	g_main_loop_unref (loop);
+	libddc_device_get_stats (device, LIBDDC_DEVICE_STATS_KIND_GET, &stats);
+	g_assert_cmpint (stats.transactions, ==, 1);
+	g_assert_cmpint (stats.sleep_time, >, 0);
+
+	/* the set is still settling, so both the request and reply waited */
+	for (i=0, sum=0; i<LIBDDC_DEVICE_STATS_BUCKETS; i++)
+		sum += stats.sleep_histogram[i];
+	g_assert_cmpint (sum, ==, 2);
+
+	g_object_unref (control);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+static const guchar libddc_test_batch_profile[] = {
+	0x10, 0x12, 0x16, 0x18, 0x1a, 0x59, 0x5a, 0x5b, 0x5c, 0x5d,
+	0x5e, 0x62, 0x6c, 0x6e, 0x70, 0x87, 0x8a, 0x8f, 0x90, 0x91 };
+#define LIBDDC_TEST_PROFILE_CAPS	"(prot(monitor)type(lcd)model(PROFILE)" \
+					"vcp(10 12 16 18 1A 59 5A 5B 5C 5D 5E 62 " \
+					"6C 6E 70 87 8A 8F 90 91))"
+
+static void
+libddc_test_batch_func (void)
+{
+	gboolean ret;
+	guint i;
+	GArray *results;
+	GError *error = NULL;
+	LibddcBatch *batch;
+	LibddcBatchResult *result;
+	LibddcDevice *device;
+	LibddcSimulator *simulator;
+
+	simulator = libddc_simulator_new ();
+	libddc_simulator_set_caps (simulator, LIBDDC_TEST_PROFILE_CAPS);
+	for (i=0; i<G_N_ELEMENTS(libddc_test_batch_profile); i++)
+		libddc_simulator_set_vcp (simulator, libddc_test_batch_profile[i], 50, 100);
+	device = libddc_device_new ();
+	libddc_simulator_attach (simulator, device);
+	ret = libddc_device_open (device, "simulator", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* set and read back 20 controls, then one unsupported control */
+	batch = libddc_batch_new (device);
+	for (i=0; i<G_N_ELEMENTS(libddc_test_batch_profile); i++) {
+		libddc_batch_add_set (batch, libddc_test_batch_profile[i], 20 + i);
+		libddc_batch_add_get (batch, libddc_test_batch_profile[i]);
+	}
+	libddc_batch_add_get (batch, 0xaa);
+	ret = libddc_batch_execute (batch, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* check the per-operation results */
+	results = libddc_batch_get_results (batch);
+	g_assert_cmpint (results->len, ==, 41);
+	g_assert_cmpint (libddc_batch_get_failed (batch), ==, 1);
+	result = &g_array_index (results, LibddcBatchResult, 1);
+	g_assert_no_error (result->error);
+	g_assert_cmpint (result->kind, ==, LIBDDC_BATCH_KIND_GET);
+	g_assert_cmpint (result->value, ==, 20);
+	g_assert_cmpint (result->maximum, ==, 100);
+	result = &g_array_index (results, LibddcBatchResult, 39);
+	g_assert_no_error (result->error);
+	g_assert_cmpint (result->value, ==, 39);
+	result = &g_array_index (results, LibddcBatchResult, 40);
+	g_assert_error (result->error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_FAILED);
+
+	g_object_unref (batch);
+	g_object_unref (device);
+	g_object_unref (simulator);
+}
+
+#define LIBDDC_TEST_SCHEDULER_REQUESTS	5
+#define LIBDDC_TEST_SCHEDULER_DEVICES	4
+
+typedef struct {
+	GMainLoop	*loop;
+	guint		 index;
+	guint		 remaining;
+	guint		*devices_done;
+	guint		 devices;
+	GArray		*order;
+} LibddcTestSchedulerHelper;
+
+static void
+libddc_test_scheduler_send (LibddcDevice *device, LibddcTestSchedulerHelper *helper);
+
+static void
+libddc_test_scheduler_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *reply;
+	GError *error = NULL;
+	LibddcTestSchedulerHelper *helper = (LibddcTestSchedulerHelper *) user_data;
+
+	reply = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	g_assert_no_error (error);
+	g_assert (reply != NULL);
+	g_bytes_unref (reply);
+	g_array_append_val (helper->order, helper->index);
+
+	if (--helper->remaining > 0) {
+		libddc_test_scheduler_send (LIBDDC_DEVICE (source), helper);
+		return;
+	}
+	if (++(*helper->devices_done) == helper->devices)
+		g_main_loop_quit (helper->loop);
+}
+
+static void
+libddc_test_scheduler_send (LibddcDevice *device, LibddcTestSchedulerHelper *helper)
+{
+	const guchar buf[] = { LIBDDC_VCP_REQUEST, LIBDDC_CONTROL_ID_BRIGHTNESS };
+	libddc_device_command_async (device, buf, sizeof(buf), 8, NULL,
+				     libddc_test_scheduler_cb, helper);
+}
+
+static void
+libddc_test_scheduler_func (void)
+{
+	gboolean ret;
+	guint devices_done = 0;
+	guint i;
+	guint seen[LIBDDC_TEST_SCHEDULER_DEVICES];
+	GArray *order;
+	GError *error = NULL;
+	GMainLoop *loop;
+	LibddcDevice *device[LIBDDC_TEST_SCHEDULER_DEVICES];
+	LibddcScheduler *scheduler;
+	LibddcSimulator *simulator[LIBDDC_TEST_SCHEDULER_DEVICES];
+	LibddcTestSchedulerHelper helper[LIBDDC_TEST_SCHEDULER_DEVICES];
+
+	loop = g_main_loop_new (NULL, FALSE);
+	order = g_array_new (FALSE, FALSE, sizeof (guint));
+	scheduler = libddc_scheduler_new ();
+	for (i=0; i<LIBDDC_TEST_SCHEDULER_DEVICES; i++) {
+		simulator[i] = libddc_simulator_new ();
+		device[i] = libddc_device_new ();
+		libddc_simulator_attach (simulator[i], device[i]);
+
+		/* only time the requests, not the capabilities */
+		ret = libddc_device_ensure_startup (device[i], &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		libddc_scheduler_add_device (scheduler, device[i]);
+		helper[i].loop = loop;
+		helper[i].index = i;
+		helper[i].remaining = LIBDDC_TEST_SCHEDULER_REQUESTS;
+		helper[i].devices_done = &devices_done;
+		helper[i].devices = LIBDDC_TEST_SCHEDULER_DEVICES;
+		helper[i].order = order;
+		seen[i] = 0;
+	}
+
+	for (i=0; i<LIBDDC_TEST_SCHEDULER_DEVICES; i++)
+		libddc_test_scheduler_send (device[i], &helper[i]);
+	g_main_loop_run (loop);
+	g_assert_cmpint (libddc_scheduler_get_pending (scheduler), ==, 0);
+
+	/* the waits on different buses overlap, so every display gets its
+	 * nth reply before any display gets its next one */
+	g_assert_cmpint (order->len, ==, LIBDDC_TEST_SCHEDULER_DEVICES * LIBDDC_TEST_SCHEDULER_REQUESTS);
+	for (i=0; i<order->len; i++)
+		g_assert_cmpint (seen[g_array_index (order, guint, i)]++, ==, i / LIBDDC_TEST_SCHEDULER_DEVICES);
+
+	for (i=0; i<LIBDDC_TEST_SCHEDULER_DEVICES; i++) {
+		libddc_scheduler_remove_device (scheduler, device[i]);
+		g_object_unref (device[i]);
+		g_object_unref (simulator[i]);
+	}
+	g_array_unref (order);
+	g_object_unref (scheduler);
+	g_main_loop_unref (loop);
+}
+
 int
 main (int argc, char **argv)
 {
 	g_type_init ();
 
+	/* do not touch the real cache */
+	g_setenv ("XDG_CACHE_HOME", "/tmp/libddc-self-test", TRUE);
+	g_unlink ("/tmp/libddc-self-test/libddc/capabilities.conf");
+	g_unlink ("/tmp/libddc-self-test/libddc/timings.conf");
+
 	g_test_init (&argc, &argv, NULL);
 
 	/* tests go here */
 	g_test_add_func ("/libddc-glib/device", libddc_test_device_func);
 	g_test_add_func ("/libddc-glib/client", libddc_test_client_func);
+	g_test_add_func ("/libddc-glib/simulator", libddc_test_simulator_func);
+	g_test_add_func ("/libddc-glib/calibrate", libddc_test_calibrate_func);
+	g_test_add_func ("/libddc-glib/edid", libddc_test_edid_func);
+	g_test_add_func ("/libddc-glib/edid-sysfs", libddc_test_edid_sysfs_func);
+	g_test_add_func ("/libddc-glib/lazy", libddc_test_lazy_func);
+	g_test_add_func ("/libddc-glib/caps-cache", libddc_test_caps_cache_func);
+	g_test_add_func ("/libddc-glib/caps-retry", libddc_test_caps_retry_func);
+	g_test_add_func ("/libddc-glib/caps-corpus", libddc_test_caps_corpus_func);
+	g_test_add_func ("/libddc-glib/store", libddc_test_store_func);
+#ifdef __GLIBC__
+	g_test_add_func ("/libddc-glib/poll", libddc_test_poll_func);
+#endif
+	g_test_add_func ("/libddc-glib/deadline", libddc_test_deadline_func);
+	g_test_add_func ("/libddc-glib/async", libddc_test_async_func);
+	g_test_add_func ("/libddc-glib/async-startup", libddc_test_async_startup_func);
+	g_test_add_func ("/libddc-glib/controls-async", libddc_test_controls_async_func);
+	g_test_add_func ("/libddc-glib/scheduler", libddc_test_scheduler_func);
+	g_test_add_func ("/libddc-glib/cache", libddc_test_cache_func);
+	g_test_add_func ("/libddc-glib/stream", libddc_test_stream_func);
+	g_test_add_func ("/libddc-glib/watcher", libddc_test_watcher_func);
+	g_test_add_func ("/libddc-glib/snapshot", libddc_test_snapshot_func);
+	g_test_add_func ("/libddc-glib/reconcile", libddc_test_reconcile_func);
+	g_test_add_func ("/libddc-glib/table", libddc_test_table_func);
+	g_test_add_func ("/libddc-glib/retry", libddc_test_retry_func);
+	g_test_add_func ("/libddc-glib/stats", libddc_test_stats_func);
+	g_test_add_func ("/libddc-glib/batch", libddc_test_batch_func);
 
 	return g_test_run ();
 }
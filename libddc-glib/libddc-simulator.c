@@ -0,0 +1,683 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-simulator
+ * @short_description: An in-process simulated DDC/CI display
+ *
+ * A GObject that answers EDID, VCP and capabilities requests like a real
+ * display would, so the protocol code can be tested and benchmarked on
+ * machines without any monitors attached.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <string.h>
+
+#include <libddc-control.h>
+#include <libddc-device.h>
+#include <libddc-simulator.h>
+
+static void     libddc_simulator_finalize	(GObject     *object);
+
+#define LIBDDC_SIMULATOR_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_SIMULATOR, LibddcSimulatorPrivate))
+
+/* the most data the display returns in one capabilities reply */
+#define LIBDDC_SIMULATOR_CAPS_FRAGMENT		32
+#define LIBDDC_SIMULATOR_TABLE_FRAGMENT		32
+#define LIBDDC_SIMULATOR_MAX_FRAME		(LIBDDC_SIMULATOR_CAPS_FRAGMENT + 6)
+#define LIBDDC_SIMULATOR_EDID_LENGTH		128
+#define LIBDDC_SIMULATOR_SEGMENT_ADDR		0x30
+
+#define LIBDDC_SIMULATOR_DEFAULT_CAPS		"(prot(monitor)type(lcd)model(LIBDDC SIMULATOR)" \
+						"cmds(01 02 03 07 0C F3)" \
+						"vcp(02 04 05 0C 10 12 14(05 06 08) 16 18 1A " \
+						"60(01 03 04) 62 D6(01 04) DF)mccs_ver(2.1))"
+
+typedef struct {
+	gboolean	 supported;
+	guint16		 value;
+	guint16		 maximum;
+	guint16		 default_value;
+} LibddcSimulatorVcp;
+
+typedef struct {
+	guchar		 id;
+	guint16		 value;
+	guint16		 maximum;
+} LibddcSimulatorDefault;
+
+static const LibddcSimulatorDefault libddc_simulator_defaults[] = {
+	{ 0x02,	0x0001,	0x0002 },	/* new-control-value */
+	{ 0x04,	0x0000,	0x0001 },	/* reset-factory-defaults */
+	{ 0x05,	0x0000,	0x0001 },	/* reset-brightness-and-contrast */
+	{ 0x0c,	0x0000,	0x0001 },	/* save-current-settings */
+	{ 0x10,	0x0050,	0x0064 },	/* brightness */
+	{ 0x12,	0x0032,	0x0064 },	/* contrast */
+	{ 0x14,	0x0005,	0x0008 },	/* select-color-preset */
+	{ 0x16,	0x0032,	0x0064 },	/* red-video-gain */
+	{ 0x18,	0x0032,	0x0064 },	/* green-video-gain */
+	{ 0x1a,	0x0032,	0x0064 },	/* blue-video-gain */
+	{ 0x60,	0x0003,	0x0004 },	/* input-source-select */
+	{ 0x62,	0x0014,	0x0064 },	/* audio-speaker-volume-adjust */
+	{ 0xd6,	0x0001,	0x0004 },	/* dpms-control */
+	{ 0xdf,	0x0201,	0xffff },	/* vcp-version */
+	{ LIBDDC_VCP_ID_INVALID, 0, 0 }
+};
+
+/**
+ * LibddcSimulatorPrivate:
+ *
+ * Private #LibddcSimulator data
+ **/
+struct _LibddcSimulatorPrivate
+{
+	guint8			*edid;
+	gsize			 edid_length;
+	guint			 edid_offset;
+	guint			 edid_segment;
+	gchar			*caps;
+	LibddcSimulatorVcp	 vcp[256];
+	guchar			 reply[LIBDDC_SIMULATOR_MAX_FRAME];
+	gsize			 reply_length;
+	gulong			 latency;
+	guint			 failures;
+	GTimer			*timer;
+	guchar			 changed[256];
+	guint			 changed_len;
+	GByteArray		*tables[256];
+};
+
+G_DEFINE_TYPE (LibddcSimulator, libddc_simulator, G_TYPE_OBJECT)
+
+/**
+ * libddc_simulator_set_reply:
+ *
+ * Queue a DDC/CI frame for the host to read back
+ **/
+static void
+libddc_simulator_set_reply (LibddcSimulator *simulator, const guchar *data, gsize length)
+{
+	guint i = 0;
+	guchar xor;
+	guchar *buf = simulator->priv->reply;
+
+	/* the host checks the frame from a different initial xor */
+	xor = 0x50;
+	xor ^= (buf[i++] = LIBDDC_DEFAULT_DDCCI_ADDR << 1);
+	xor ^= (buf[i++] = 0x80 | length);
+	while (length--)
+		xor ^= (buf[i++] = *data++);
+	buf[i++] = xor;
+	simulator->priv->reply_length = i;
+}
+
+/**
+ * libddc_simulator_reset_vcp:
+ **/
+static void
+libddc_simulator_reset_vcp (LibddcSimulator *simulator, guchar id)
+{
+	LibddcSimulatorVcp *vcp = &simulator->priv->vcp[id];
+	if (vcp->supported)
+		vcp->value = vcp->default_value;
+}
+
+/**
+ * libddc_simulator_process:
+ *
+ * Act on a valid DDC/CI payload sent by the host
+ **/
+static void
+libddc_simulator_process (LibddcSimulator *simulator, const guchar *data, gsize length)
+{
+	guint i;
+	guint offset;
+	gsize caps_length;
+	guchar buf[LIBDDC_SIMULATOR_MAX_FRAME];
+	LibddcSimulatorVcp *vcp;
+	LibddcSimulatorPrivate *priv = simulator->priv;
+
+	/* any new command invalidates the old reply */
+	priv->reply_length = 0;
+
+	switch (data[0]) {
+	case LIBDDC_VCP_REQUEST:
+		if (length != 2)
+			break;
+		vcp = &priv->vcp[data[1]];
+
+		/* report and drain the controls changed on the front panel */
+		if (data[1] == LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE && vcp->supported) {
+			vcp->value = priv->changed_len > 0 ? 0x02 : 0x01;
+		} else if (data[1] == LIBDDC_CONTROL_ID_ACTIVE_CONTROL) {
+			vcp->supported = TRUE;
+			vcp->maximum = 0xff;
+			vcp->value = 0x00;
+			if (priv->changed_len > 0) {
+				vcp->value = priv->changed[0];
+				priv->changed_len--;
+				memmove (priv->changed, priv->changed + 1, priv->changed_len);
+			}
+		}
+		buf[0] = LIBDDC_VCP_REPLY;
+		buf[1] = vcp->supported ? 0x00 : 0x01;
+		buf[2] = data[1];
+		buf[3] = 0x00;
+		buf[4] = vcp->maximum >> 8;
+		buf[5] = vcp->maximum & 0xff;
+		buf[6] = vcp->value >> 8;
+		buf[7] = vcp->value & 0xff;
+		libddc_simulator_set_reply (simulator, buf, 8);
+		break;
+	case LIBDDC_VCP_SET:
+		if (length != 4)
+			break;
+		vcp = &priv->vcp[data[1]];
+		if (!vcp->supported)
+			break;
+		vcp->value = data[2] * 256 + data[3];
+
+		/* the reset controls act on other controls */
+		if (data[1] == 0x04 && vcp->value != 0) {
+			for (i=0; i<G_N_ELEMENTS (priv->vcp); i++)
+				libddc_simulator_reset_vcp (simulator, i);
+		} else if (data[1] == 0x05 && vcp->value != 0) {
+			libddc_simulator_reset_vcp (simulator, 0x10);
+			libddc_simulator_reset_vcp (simulator, 0x12);
+			vcp->value = 0;
+		}
+		break;
+	case LIBDDC_VCP_RESET:
+		if (length != 2)
+			break;
+		libddc_simulator_reset_vcp (simulator, data[1]);
+		break;
+	case LIBDDC_TABLE_READ_REQUEST:
+		if (length != 4 || priv->tables[data[1]] == NULL)
+			break;
+		offset = data[2] * 256 + data[3];
+		buf[0] = LIBDDC_TABLE_READ_REPLY;
+		buf[1] = data[2];
+		buf[2] = data[3];
+		length = 0;
+		if (offset < priv->tables[data[1]]->len)
+			length = MIN (priv->tables[data[1]]->len - offset, LIBDDC_SIMULATOR_TABLE_FRAGMENT);
+		memcpy (buf + 3, priv->tables[data[1]]->data + offset, length);
+		libddc_simulator_set_reply (simulator, buf, length + 3);
+		break;
+	case LIBDDC_TABLE_WRITE:
+		if (length < 4 || priv->tables[data[1]] == NULL)
+			break;
+		offset = data[2] * 256 + data[3];
+		if (offset + length - 4 > priv->tables[data[1]]->len)
+			g_byte_array_set_size (priv->tables[data[1]], offset + length - 4);
+		memcpy (priv->tables[data[1]]->data + offset, data + 4, length - 4);
+		break;
+	case LIBDDC_CAPABILITIES_REQUEST:
+		if (length != 3)
+			break;
+		offset = data[1] * 256 + data[2];
+		caps_length = strlen (priv->caps);
+		buf[0] = LIBDDC_CAPABILITIES_REPLY;
+		buf[1] = data[1];
+		buf[2] = data[2];
+		length = 0;
+		if (offset < caps_length)
+			length = MIN (caps_length - offset, LIBDDC_SIMULATOR_CAPS_FRAGMENT);
+		memcpy (buf + 3, priv->caps + offset, length);
+		libddc_simulator_set_reply (simulator, buf, length + 3);
+		break;
+	default:
+		/* presence, save and application report need no reply */
+		break;
+	}
+}
+
+/**
+ * libddc_simulator_transport_open:
+ **/
+static gboolean
+libddc_simulator_transport_open (LibddcDevice *device, const gchar *filename, gpointer user_data, GError **error)
+{
+	LibddcSimulator *simulator = LIBDDC_SIMULATOR (user_data);
+	simulator->priv->reply_length = 0;
+	simulator->priv->edid_offset = 0;
+	simulator->priv->edid_segment = 0;
+	g_timer_reset (simulator->priv->timer);
+	return TRUE;
+}
+
+/**
+ * libddc_simulator_transport_write:
+ **/
+static gboolean
+libddc_simulator_transport_write (LibddcDevice *device, guint addr, const guchar *data, gsize length, LibddcDeviceError *kind, gpointer user_data, GError **error)
+{
+	guint i;
+	guchar xor;
+	gsize len;
+	LibddcSimulator *simulator = LIBDDC_SIMULATOR (user_data);
+	LibddcSimulatorPrivate *priv = simulator->priv;
+
+	/* set the E-DDC segment for the next EDID read */
+	if (addr == LIBDDC_SIMULATOR_SEGMENT_ADDR) {
+		priv->edid_segment = length > 0 ? data[0] : 0;
+		return TRUE;
+	}
+
+	/* set the EDID offset */
+	if (addr == LIBDDC_DEFAULT_EDID_ADDR) {
+		priv->edid_offset = priv->edid_segment * 256;
+		if (length > 0)
+			priv->edid_offset += data[0];
+		return TRUE;
+	}
+
+	/* nothing at this address */
+	if (addr != LIBDDC_DEFAULT_DDCCI_ADDR) {
+		*kind = LIBDDC_DEVICE_ERROR_NACK;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_NACK,
+			     "no simulated device at 0x%02x", addr);
+		return FALSE;
+	}
+
+	/* the reply latency starts now */
+	g_timer_reset (priv->timer);
+
+	/* a real display silently drops invalid frames */
+	if (length < 3 || data[0] != 0x51)
+		return TRUE;
+	len = data[1] & ~0x80;
+	if (len == 0 || len + 3 != length)
+		return TRUE;
+	xor = addr << 1;
+	for (i=0; i<length; i++)
+		xor ^= data[i];
+	if (xor != 0)
+		return TRUE;
+
+	libddc_simulator_process (simulator, data + 2, len);
+	return TRUE;
+}
+
+/**
+ * libddc_simulator_transport_read:
+ **/
+static gboolean
+libddc_simulator_transport_read (LibddcDevice *device, guint addr, guchar *data, gsize data_length, gsize *recieved_length, LibddcDeviceError *kind, gpointer user_data, GError **error)
+{
+	gsize len;
+	gdouble elapsed;
+	LibddcSimulator *simulator = LIBDDC_SIMULATOR (user_data);
+	LibddcSimulatorPrivate *priv = simulator->priv;
+	static const guchar null_message[] = { LIBDDC_DEFAULT_DDCCI_ADDR << 1, 0x80, 0xbe };
+
+	/* read the EDID from the current offset */
+	if (addr == LIBDDC_DEFAULT_EDID_ADDR) {
+		memset (data, 0xff, data_length);
+		if (priv->edid_offset < priv->edid_length) {
+			len = MIN (data_length, priv->edid_length - priv->edid_offset);
+			memcpy (data, priv->edid + priv->edid_offset, len);
+		}
+		priv->edid_offset += data_length;
+		priv->edid_segment = 0;
+		goto out;
+	}
+
+	/* nothing at this address */
+	if (addr != LIBDDC_DEFAULT_DDCCI_ADDR) {
+		*kind = LIBDDC_DEVICE_ERROR_NACK;
+		g_set_error (error, LIBDDC_DEVICE_ERROR, LIBDDC_DEVICE_ERROR_NACK,
+			     "no simulated device at 0x%02x", addr);
+		return FALSE;
+	}
+
+	/* nothing to say */
+	memset (data, 0x00, data_length);
+	if (priv->reply_length == 0) {
+		memcpy (data, null_message, MIN (data_length, sizeof (null_message)));
+		goto out;
+	}
+
+	/* a flaky display loses the reply altogether */
+	if (priv->failures > 0) {
+		priv->failures--;
+		priv->reply_length = 0;
+		memcpy (data, null_message, MIN (data_length, sizeof (null_message)));
+		goto out;
+	}
+
+	/* copy the pending reply */
+	memcpy (data, priv->reply, MIN (data_length, priv->reply_length));
+
+	/* the host asked too early, so the reply is still being assembled */
+	elapsed = g_timer_elapsed (priv->timer, NULL);
+	if (elapsed * G_USEC_PER_SEC < priv->latency) {
+		if (data_length >= priv->reply_length)
+			data[priv->reply_length - 1] ^= 0xff;
+		goto out;
+	}
+
+	/* replies can only be read once */
+	priv->reply_length = 0;
+out:
+	if (recieved_length != NULL)
+		*recieved_length = data_length;
+	return TRUE;
+}
+
+static const LibddcDeviceTransport libddc_simulator_transport = {
+	libddc_simulator_transport_open,
+	libddc_simulator_transport_read,
+	libddc_simulator_transport_write,
+	NULL
+};
+
+/**
+ * libddc_simulator_attach:
+ * @simulator: a #LibddcSimulator
+ * @device: a #LibddcDevice that has not yet been opened
+ *
+ * Connects @device to the simulated display rather than to a real bus.
+ * The filename passed to libddc_device_open() is then ignored.
+ **/
+void
+libddc_simulator_attach (LibddcSimulator *simulator, LibddcDevice *device)
+{
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+	g_return_if_fail (LIBDDC_IS_DEVICE(device));
+
+	libddc_device_set_transport (device, &libddc_simulator_transport,
+				     g_object_ref (simulator),
+				     (GDestroyNotify) g_object_unref);
+}
+
+/**
+ * libddc_simulator_set_latency:
+ * @simulator: a #LibddcSimulator
+ * @latency: the time in microseconds the display needs to prepare a reply
+ *
+ * Replies read back sooner than this after the request fail the checksum,
+ * just like a slow display answering before it is ready.
+ **/
+void
+libddc_simulator_set_latency (LibddcSimulator *simulator, gulong latency)
+{
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+	simulator->priv->latency = latency;
+}
+
+/**
+ * libddc_simulator_set_edid:
+ **/
+void
+libddc_simulator_set_edid (LibddcSimulator *simulator, const guint8 *data, gsize length)
+{
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+	g_return_if_fail (data != NULL);
+
+	g_free (simulator->priv->edid);
+	simulator->priv->edid = g_new (guint8, length);
+	memcpy (simulator->priv->edid, data, length);
+	simulator->priv->edid_length = length;
+}
+
+/**
+ * libddc_simulator_set_failures:
+ * @simulator: a #LibddcSimulator
+ * @failures: the number of replies to lose
+ *
+ * Makes the display lose the next few replies, like a flaky display
+ * on a long cable would.
+ **/
+void
+libddc_simulator_set_failures (LibddcSimulator *simulator, guint failures)
+{
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+	simulator->priv->failures = failures;
+}
+
+/**
+ * libddc_simulator_set_caps:
+ **/
+void
+libddc_simulator_set_caps (LibddcSimulator *simulator, const gchar *caps)
+{
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+	g_return_if_fail (caps != NULL);
+
+	g_free (simulator->priv->caps);
+	simulator->priv->caps = g_strdup (caps);
+}
+
+/**
+ * libddc_simulator_set_vcp:
+ *
+ * Makes the control supported, and sets both the current and the reset value.
+ **/
+void
+libddc_simulator_set_vcp (LibddcSimulator *simulator, guchar id, guint16 value, guint16 maximum)
+{
+	LibddcSimulatorVcp *vcp;
+
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+
+	vcp = &simulator->priv->vcp[id];
+	vcp->supported = TRUE;
+	vcp->value = value;
+	vcp->default_value = value;
+	vcp->maximum = maximum;
+}
+
+/**
+ * libddc_simulator_set_table:
+ *
+ * Makes the table control supported, with the given contents.
+ **/
+void
+libddc_simulator_set_table (LibddcSimulator *simulator, guchar id, const guint8 *data, gsize length)
+{
+	LibddcSimulatorPrivate *priv;
+
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+
+	priv = simulator->priv;
+	if (priv->tables[id] == NULL)
+		priv->tables[id] = g_byte_array_new ();
+	g_byte_array_set_size (priv->tables[id], 0);
+	g_byte_array_append (priv->tables[id], data, length);
+}
+
+/**
+ * libddc_simulator_get_table:
+ *
+ * Return value: the table contents, or %NULL if not supported
+ **/
+const guint8 *
+libddc_simulator_get_table (LibddcSimulator *simulator, guchar id, gsize *length)
+{
+	GByteArray *table;
+
+	g_return_val_if_fail (LIBDDC_IS_SIMULATOR(simulator), NULL);
+
+	table = simulator->priv->tables[id];
+	if (table == NULL)
+		return NULL;
+	if (length != NULL)
+		*length = table->len;
+	return table->data;
+}
+
+/**
+ * libddc_simulator_change_vcp:
+ *
+ * Changes a control as if the user had used the buttons on the display,
+ * which the host can discover using the Active Control FIFO.
+ **/
+void
+libddc_simulator_change_vcp (LibddcSimulator *simulator, guchar id, guint16 value)
+{
+	guint i;
+	LibddcSimulatorPrivate *priv;
+
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+
+	priv = simulator->priv;
+	priv->vcp[id].value = value;
+	for (i=0; i<priv->changed_len; i++) {
+		if (priv->changed[i] == id)
+			return;
+	}
+	priv->changed[priv->changed_len++] = id;
+}
+
+/**
+ * libddc_simulator_get_vcp:
+ *
+ * Return value: %TRUE if the control is supported by the display
+ **/
+gboolean
+libddc_simulator_get_vcp (LibddcSimulator *simulator, guchar id, guint16 *value, guint16 *maximum)
+{
+	LibddcSimulatorVcp *vcp;
+
+	g_return_val_if_fail (LIBDDC_IS_SIMULATOR(simulator), FALSE);
+
+	vcp = &simulator->priv->vcp[id];
+	if (!vcp->supported)
+		return FALSE;
+	if (value != NULL)
+		*value = vcp->value;
+	if (maximum != NULL)
+		*maximum = vcp->maximum;
+	return TRUE;
+}
+
+/**
+ * libddc_simulator_set_default_edid:
+ **/
+static void
+libddc_simulator_set_default_edid (LibddcSimulator *simulator)
+{
+	guint i;
+	guint8 sum = 0;
+	guint8 edid[LIBDDC_SIMULATOR_EDID_LENGTH];
+	static guint32 serial = 0;
+	static const guint8 header[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+	memset (edid, 0x00, sizeof (edid));
+	memcpy (edid, header, sizeof (header));
+
+	/* manufacturer 'SIM', product 0x0001 */
+	edid[8] = 0x4d;
+	edid[9] = 0x2d;
+	edid[10] = 0x01;
+
+	/* each display gets a new serial so the EDID hashes differ */
+	serial++;
+	edid[12] = serial & 0xff;
+	edid[13] = (serial >> 8) & 0xff;
+	edid[14] = (serial >> 16) & 0xff;
+	edid[15] = (serial >> 24) & 0xff;
+
+	/* EDID 1.3 */
+	edid[18] = 0x01;
+	edid[19] = 0x03;
+
+	/* the block has to sum to zero */
+	for (i=0; i<sizeof (edid) - 1; i++)
+		sum += edid[i];
+	edid[sizeof (edid) - 1] = 0x100 - sum;
+
+	libddc_simulator_set_edid (simulator, edid, sizeof (edid));
+}
+
+/**
+ * libddc_simulator_class_init:
+ **/
+static void
+libddc_simulator_class_init (LibddcSimulatorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_simulator_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcSimulatorPrivate));
+}
+
+/**
+ * libddc_simulator_init:
+ **/
+static void
+libddc_simulator_init (LibddcSimulator *simulator)
+{
+	guint i;
+
+	simulator->priv = LIBDDC_SIMULATOR_GET_PRIVATE (simulator);
+	simulator->priv->caps = g_strdup (LIBDDC_SIMULATOR_DEFAULT_CAPS);
+	simulator->priv->timer = g_timer_new ();
+	libddc_simulator_set_default_edid (simulator);
+	for (i=0; libddc_simulator_defaults[i].id != LIBDDC_VCP_ID_INVALID; i++) {
+		libddc_simulator_set_vcp (simulator,
+					  libddc_simulator_defaults[i].id,
+					  libddc_simulator_defaults[i].value,
+					  libddc_simulator_defaults[i].maximum);
+	}
+}
+
+/**
+ * libddc_simulator_finalize:
+ **/
+static void
+libddc_simulator_finalize (GObject *object)
+{
+	guint i;
+	LibddcSimulator *simulator = LIBDDC_SIMULATOR (object);
+	LibddcSimulatorPrivate *priv = simulator->priv;
+
+	g_return_if_fail (LIBDDC_IS_SIMULATOR(simulator));
+
+	g_free (priv->edid);
+	g_free (priv->caps);
+	g_timer_destroy (priv->timer);
+	for (i=0; i<G_N_ELEMENTS (priv->tables); i++) {
+		if (priv->tables[i] != NULL)
+			g_byte_array_unref (priv->tables[i]);
+	}
+
+	G_OBJECT_CLASS (libddc_simulator_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_simulator_new:
+ *
+ * Return value: A new %LibddcSimulator instance
+ *
+ * Since: 0.0.1
+ **/
+LibddcSimulator *
+libddc_simulator_new (void)
+{
+	LibddcSimulator *simulator;
+	simulator = g_object_new (LIBDDC_TYPE_SIMULATOR, NULL);
+	return LIBDDC_SIMULATOR (simulator);
+}
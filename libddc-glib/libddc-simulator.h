@@ -0,0 +1,100 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_SIMULATOR_H
+#define __LIBDDC_SIMULATOR_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+#include <libddc-device.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_SIMULATOR		(libddc_simulator_get_type ())
+#define LIBDDC_SIMULATOR(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_SIMULATOR, LibddcSimulator))
+#define LIBDDC_SIMULATOR_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_SIMULATOR, LibddcSimulatorClass))
+#define LIBDDC_IS_SIMULATOR(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_SIMULATOR))
+#define LIBDDC_IS_SIMULATOR_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_SIMULATOR))
+#define LIBDDC_SIMULATOR_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_SIMULATOR, LibddcSimulatorClass))
+
+typedef struct _LibddcSimulatorPrivate		LibddcSimulatorPrivate;
+typedef struct _LibddcSimulator			LibddcSimulator;
+typedef struct _LibddcSimulatorClass		LibddcSimulatorClass;
+
+struct _LibddcSimulator
+{
+	 GObject		 parent;
+	 LibddcSimulatorPrivate	*priv;
+};
+
+struct _LibddcSimulatorClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GType		 libddc_simulator_get_type		(void);
+LibddcSimulator	*libddc_simulator_new			(void);
+
+void		 libddc_simulator_attach		(LibddcSimulator *simulator,
+							 LibddcDevice	*device);
+void		 libddc_simulator_set_latency		(LibddcSimulator *simulator,
+							 gulong		 latency);
+void		 libddc_simulator_set_failures		(LibddcSimulator *simulator,
+							 guint		 failures);
+void		 libddc_simulator_set_edid		(LibddcSimulator *simulator,
+							 const guint8	*data,
+							 gsize		 length);
+void		 libddc_simulator_set_caps		(LibddcSimulator *simulator,
+							 const gchar	*caps);
+void		 libddc_simulator_set_vcp		(LibddcSimulator *simulator,
+							 guchar		 id,
+							 guint16	 value,
+							 guint16	 maximum);
+void		 libddc_simulator_set_table		(LibddcSimulator *simulator,
+							 guchar		 id,
+							 const guint8	*data,
+							 gsize		 length);
+const guint8	*libddc_simulator_get_table		(LibddcSimulator *simulator,
+							 guchar		 id,
+							 gsize		*length);
+void		 libddc_simulator_change_vcp		(LibddcSimulator *simulator,
+							 guchar		 id,
+							 guint16	 value);
+gboolean	 libddc_simulator_get_vcp		(LibddcSimulator *simulator,
+							 guchar		 id,
+							 guint16	*value,
+							 guint16	*maximum);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_SIMULATOR_H */
+
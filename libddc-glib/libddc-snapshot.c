@@ -0,0 +1,392 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-snapshot
+ * @short_description: The saved state of every control on a display
+ *
+ * A snapshot records the value and maximum of every readable control
+ * of one display, as returned by libddc_device_snapshot(). It can be
+ * saved with libddc_snapshot_to_data() and loaded again later to audit
+ * or restore the settings.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include <libddc-snapshot.h>
+
+static void     libddc_snapshot_finalize	(GObject     *object);
+
+#define LIBDDC_SNAPSHOT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_SNAPSHOT, LibddcSnapshotPrivate))
+
+#define LIBDDC_SNAPSHOT_GROUP			"Snapshot"
+#define LIBDDC_SNAPSHOT_GROUP_CONTROLS		"Controls"
+
+/**
+ * LibddcSnapshotPrivate:
+ *
+ * Private #LibddcSnapshot data
+ **/
+struct _LibddcSnapshotPrivate
+{
+	gchar			*edid_md5;
+	gdouble			 elapsed;
+	guint			 failed;
+	GArray			*entries;
+};
+
+G_DEFINE_TYPE (LibddcSnapshot, libddc_snapshot, G_TYPE_OBJECT)
+
+/**
+ * libddc_snapshot_add:
+ * @snapshot: a #LibddcSnapshot
+ * @id: the control ID
+ * @value: the current value
+ * @maximum: the maximum value
+ *
+ * Adds a control to the snapshot, replacing any existing entry.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_snapshot_add (LibddcSnapshot *snapshot, guchar id, guint16 value, guint16 maximum)
+{
+	guint i;
+	LibddcSnapshotEntry entry;
+	LibddcSnapshotEntry *tmp;
+
+	g_return_if_fail (LIBDDC_IS_SNAPSHOT(snapshot));
+
+	for (i=0; i<snapshot->priv->entries->len; i++) {
+		tmp = &g_array_index (snapshot->priv->entries, LibddcSnapshotEntry, i);
+		if (tmp->id == id) {
+			tmp->value = value;
+			tmp->maximum = maximum;
+			return;
+		}
+	}
+	entry.id = id;
+	entry.value = value;
+	entry.maximum = maximum;
+	g_array_append_val (snapshot->priv->entries, entry);
+}
+
+/**
+ * libddc_snapshot_lookup:
+ * @snapshot: a #LibddcSnapshot
+ * @id: the control ID
+ * @value: (out): the value, or %NULL
+ * @maximum: (out): the maximum value, or %NULL
+ *
+ * Return value: %TRUE if the control is in the snapshot
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_snapshot_lookup (LibddcSnapshot *snapshot, guchar id, guint16 *value, guint16 *maximum)
+{
+	guint i;
+	LibddcSnapshotEntry *entry;
+
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), FALSE);
+
+	for (i=0; i<snapshot->priv->entries->len; i++) {
+		entry = &g_array_index (snapshot->priv->entries, LibddcSnapshotEntry, i);
+		if (entry->id != id)
+			continue;
+		if (value != NULL)
+			*value = entry->value;
+		if (maximum != NULL)
+			*maximum = entry->maximum;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * libddc_snapshot_get_entries:
+ * @snapshot: a #LibddcSnapshot
+ *
+ * Return value: (transfer none): an array of #LibddcSnapshotEntry
+ *
+ * Since: 0.0.1
+ **/
+GArray *
+libddc_snapshot_get_entries (LibddcSnapshot *snapshot)
+{
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), NULL);
+	return snapshot->priv->entries;
+}
+
+/**
+ * libddc_snapshot_set_edid_md5:
+ **/
+void
+libddc_snapshot_set_edid_md5 (LibddcSnapshot *snapshot, const gchar *edid_md5)
+{
+	g_return_if_fail (LIBDDC_IS_SNAPSHOT(snapshot));
+	g_free (snapshot->priv->edid_md5);
+	snapshot->priv->edid_md5 = g_strdup (edid_md5);
+}
+
+/**
+ * libddc_snapshot_get_edid_md5:
+ *
+ * Return value: the EDID hash of the display, or %NULL if unknown
+ **/
+const gchar *
+libddc_snapshot_get_edid_md5 (LibddcSnapshot *snapshot)
+{
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), NULL);
+	return snapshot->priv->edid_md5;
+}
+
+/**
+ * libddc_snapshot_set_elapsed:
+ **/
+void
+libddc_snapshot_set_elapsed (LibddcSnapshot *snapshot, gdouble elapsed)
+{
+	g_return_if_fail (LIBDDC_IS_SNAPSHOT(snapshot));
+	snapshot->priv->elapsed = elapsed;
+}
+
+/**
+ * libddc_snapshot_get_elapsed:
+ *
+ * Return value: the time taken to read the display in seconds
+ **/
+gdouble
+libddc_snapshot_get_elapsed (LibddcSnapshot *snapshot)
+{
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), 0.0f);
+	return snapshot->priv->elapsed;
+}
+
+/**
+ * libddc_snapshot_set_failed:
+ **/
+void
+libddc_snapshot_set_failed (LibddcSnapshot *snapshot, guint failed)
+{
+	g_return_if_fail (LIBDDC_IS_SNAPSHOT(snapshot));
+	snapshot->priv->failed = failed;
+}
+
+/**
+ * libddc_snapshot_get_failed:
+ *
+ * Return value: the number of controls that could not be read
+ **/
+guint
+libddc_snapshot_get_failed (LibddcSnapshot *snapshot)
+{
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), 0);
+	return snapshot->priv->failed;
+}
+
+/**
+ * libddc_snapshot_to_data:
+ * @snapshot: a #LibddcSnapshot
+ * @length: (out): the length of the data, or %NULL
+ *
+ * Return value: the snapshot as key file data, free with g_free()
+ *
+ * Since: 0.0.1
+ **/
+gchar *
+libddc_snapshot_to_data (LibddcSnapshot *snapshot, gsize *length)
+{
+	gchar *data;
+	gchar key[3];
+	gint values[2];
+	guint i;
+	GKeyFile *keyfile;
+	LibddcSnapshotEntry *entry;
+	LibddcSnapshotPrivate *priv;
+
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), NULL);
+
+	priv = snapshot->priv;
+	keyfile = g_key_file_new ();
+	if (priv->edid_md5 != NULL)
+		g_key_file_set_string (keyfile, LIBDDC_SNAPSHOT_GROUP, "EdidMd5", priv->edid_md5);
+	g_key_file_set_double (keyfile, LIBDDC_SNAPSHOT_GROUP, "Elapsed", priv->elapsed);
+	g_key_file_set_integer (keyfile, LIBDDC_SNAPSHOT_GROUP, "Failed", priv->failed);
+	for (i=0; i<priv->entries->len; i++) {
+		entry = &g_array_index (priv->entries, LibddcSnapshotEntry, i);
+		g_snprintf (key, sizeof(key), "%02X", entry->id);
+		values[0] = entry->value;
+		values[1] = entry->maximum;
+		g_key_file_set_integer_list (keyfile, LIBDDC_SNAPSHOT_GROUP_CONTROLS,
+					     key, values, G_N_ELEMENTS (values));
+	}
+	data = g_key_file_to_data (keyfile, length, NULL);
+	g_key_file_free (keyfile);
+	return data;
+}
+
+/**
+ * libddc_snapshot_from_data:
+ * @snapshot: a #LibddcSnapshot
+ * @data: key file data from libddc_snapshot_to_data()
+ * @length: the length of @data, or -1 if nul terminated
+ * @error: a #GError, or %NULL
+ *
+ * Replaces the contents of the snapshot with saved data.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_snapshot_from_data (LibddcSnapshot *snapshot, const gchar *data,
+			   gsize length, GError **error)
+{
+	gboolean ret;
+	gchar *edid_md5;
+	gchar **keys = NULL;
+	gchar *endptr;
+	gint *values;
+	gsize n_values;
+	guint i;
+	guint64 id;
+	GError *error_local = NULL;
+	GKeyFile *keyfile;
+
+	g_return_val_if_fail (LIBDDC_IS_SNAPSHOT(snapshot), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	keyfile = g_key_file_new ();
+	ret = g_key_file_load_from_data (keyfile, data, length, G_KEY_FILE_NONE, &error_local);
+	if (!ret) {
+		g_set_error (error, LIBDDC_SNAPSHOT_ERROR, LIBDDC_SNAPSHOT_ERROR_FAILED,
+			     "failed to parse snapshot: %s", error_local->message);
+		g_error_free (error_local);
+		goto out;
+	}
+	ret = g_key_file_has_group (keyfile, LIBDDC_SNAPSHOT_GROUP);
+	if (!ret) {
+		g_set_error_literal (error, LIBDDC_SNAPSHOT_ERROR, LIBDDC_SNAPSHOT_ERROR_FAILED,
+				     "not a snapshot");
+		goto out;
+	}
+
+	/* replace everything */
+	g_array_set_size (snapshot->priv->entries, 0);
+	edid_md5 = g_key_file_get_string (keyfile, LIBDDC_SNAPSHOT_GROUP, "EdidMd5", NULL);
+	g_free (snapshot->priv->edid_md5);
+	snapshot->priv->edid_md5 = edid_md5;
+	snapshot->priv->elapsed = g_key_file_get_double (keyfile, LIBDDC_SNAPSHOT_GROUP, "Elapsed", NULL);
+	snapshot->priv->failed = g_key_file_get_integer (keyfile, LIBDDC_SNAPSHOT_GROUP, "Failed", NULL);
+	keys = g_key_file_get_keys (keyfile, LIBDDC_SNAPSHOT_GROUP_CONTROLS, NULL, NULL);
+	for (i=0; keys != NULL && keys[i] != NULL; i++) {
+		id = g_ascii_strtoull (keys[i], &endptr, 16);
+		values = g_key_file_get_integer_list (keyfile, LIBDDC_SNAPSHOT_GROUP_CONTROLS,
+						      keys[i], &n_values, NULL);
+		if (*endptr != '\0' || id > 0xff || values == NULL || n_values != 2) {
+			g_set_error (error, LIBDDC_SNAPSHOT_ERROR, LIBDDC_SNAPSHOT_ERROR_FAILED,
+				     "invalid control '%s'", keys[i]);
+			g_free (values);
+			ret = FALSE;
+			goto out;
+		}
+		libddc_snapshot_add (snapshot, id, values[0], values[1]);
+		g_free (values);
+	}
+out:
+	g_strfreev (keys);
+	g_key_file_free (keyfile);
+	return ret;
+}
+
+/**
+ * libddc_snapshot_error_quark:
+ *
+ * Return value: Our personal error quark.
+ *
+ * Since: 0.0.1
+ **/
+GQuark
+libddc_snapshot_error_quark (void)
+{
+	static GQuark quark = 0;
+	if (!quark)
+		quark = g_quark_from_static_string ("libddc_snapshot_error");
+	return quark;
+}
+
+/**
+ * libddc_snapshot_class_init:
+ **/
+static void
+libddc_snapshot_class_init (LibddcSnapshotClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_snapshot_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcSnapshotPrivate));
+}
+
+/**
+ * libddc_snapshot_init:
+ **/
+static void
+libddc_snapshot_init (LibddcSnapshot *snapshot)
+{
+	snapshot->priv = LIBDDC_SNAPSHOT_GET_PRIVATE (snapshot);
+	snapshot->priv->entries = g_array_new (FALSE, FALSE, sizeof(LibddcSnapshotEntry));
+}
+
+/**
+ * libddc_snapshot_finalize:
+ **/
+static void
+libddc_snapshot_finalize (GObject *object)
+{
+	LibddcSnapshot *snapshot = LIBDDC_SNAPSHOT (object);
+	LibddcSnapshotPrivate *priv = snapshot->priv;
+
+	g_return_if_fail (LIBDDC_IS_SNAPSHOT(snapshot));
+
+	g_array_unref (priv->entries);
+	g_free (priv->edid_md5);
+
+	G_OBJECT_CLASS (libddc_snapshot_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_snapshot_new:
+ *
+ * Return value: A new %LibddcSnapshot instance
+ *
+ * Since: 0.0.1
+ **/
+LibddcSnapshot *
+libddc_snapshot_new (void)
+{
+	LibddcSnapshot *snapshot;
+	snapshot = g_object_new (LIBDDC_TYPE_SNAPSHOT, NULL);
+	return LIBDDC_SNAPSHOT (snapshot);
+}
@@ -0,0 +1,121 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_SNAPSHOT_H
+#define __LIBDDC_SNAPSHOT_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_SNAPSHOT		(libddc_snapshot_get_type ())
+#define LIBDDC_SNAPSHOT(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_SNAPSHOT, LibddcSnapshot))
+#define LIBDDC_SNAPSHOT_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_SNAPSHOT, LibddcSnapshotClass))
+#define LIBDDC_IS_SNAPSHOT(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_SNAPSHOT))
+#define LIBDDC_IS_SNAPSHOT_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_SNAPSHOT))
+#define LIBDDC_SNAPSHOT_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_SNAPSHOT, LibddcSnapshotClass))
+#define LIBDDC_SNAPSHOT_ERROR		(libddc_snapshot_error_quark ())
+
+/**
+ * LibddcSnapshotError:
+ * @LIBDDC_SNAPSHOT_ERROR_FAILED: the data could not be parsed
+ *
+ * Errors that can be thrown
+ */
+typedef enum
+{
+	LIBDDC_SNAPSHOT_ERROR_FAILED
+} LibddcSnapshotError;
+
+/**
+ * LibddcSnapshotEntry:
+ * @id: the control ID
+ * @value: the value when the snapshot was taken
+ * @maximum: the maximum value
+ *
+ * One control in a snapshot
+ */
+typedef struct {
+	guchar			 id;
+	guint16			 value;
+	guint16			 maximum;
+} LibddcSnapshotEntry;
+
+typedef struct _LibddcSnapshotPrivate		LibddcSnapshotPrivate;
+typedef struct _LibddcSnapshot			LibddcSnapshot;
+typedef struct _LibddcSnapshotClass		LibddcSnapshotClass;
+
+struct _LibddcSnapshot
+{
+	 GObject		 parent;
+	 LibddcSnapshotPrivate	*priv;
+};
+
+struct _LibddcSnapshotClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GQuark		 libddc_snapshot_error_quark		(void);
+GType		 libddc_snapshot_get_type		(void);
+LibddcSnapshot	*libddc_snapshot_new			(void);
+
+void		 libddc_snapshot_add			(LibddcSnapshot	*snapshot,
+							 guchar		 id,
+							 guint16	 value,
+							 guint16	 maximum);
+gboolean	 libddc_snapshot_lookup			(LibddcSnapshot	*snapshot,
+							 guchar		 id,
+							 guint16	*value,
+							 guint16	*maximum);
+GArray		*libddc_snapshot_get_entries		(LibddcSnapshot	*snapshot);
+void		 libddc_snapshot_set_edid_md5		(LibddcSnapshot	*snapshot,
+							 const gchar	*edid_md5);
+const gchar	*libddc_snapshot_get_edid_md5		(LibddcSnapshot	*snapshot);
+void		 libddc_snapshot_set_elapsed		(LibddcSnapshot	*snapshot,
+							 gdouble	 elapsed);
+gdouble		 libddc_snapshot_get_elapsed		(LibddcSnapshot	*snapshot);
+void		 libddc_snapshot_set_failed		(LibddcSnapshot	*snapshot,
+							 guint		 failed);
+guint		 libddc_snapshot_get_failed		(LibddcSnapshot	*snapshot);
+gchar		*libddc_snapshot_to_data		(LibddcSnapshot	*snapshot,
+							 gsize		*length);
+gboolean	 libddc_snapshot_from_data		(LibddcSnapshot	*snapshot,
+							 const gchar	*data,
+							 gsize		 length,
+							 GError		**error);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_SNAPSHOT_H */
+
@@ -0,0 +1,484 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-store
+ * @short_description: Last known control values shared between processes
+ *
+ * A fixed size file that is mapped into every process using it, holding
+ * the last value and maximum read or written for each control of each
+ * display. Other processes can then find a recent value without any bus
+ * traffic. Each slot has a sequence counter that is odd while the slot
+ * is being written, so readers never see a half written value.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libddc-store.h>
+
+static void     libddc_store_finalize	(GObject     *object);
+
+#define LIBDDC_STORE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_STORE, LibddcStorePrivate))
+
+#define LIBDDC_STORE_MAGIC		"LIBDDC01"
+#define LIBDDC_STORE_SLOTS		1024
+#define LIBDDC_STORE_PROBES		16	/* slots tried for each key */
+#define LIBDDC_STORE_SPINS		1000	/* give up on a slot stuck by a crashed writer */
+#define LIBDDC_STORE_RETRIES		4	/* times to pick a new victim if one is reused */
+
+/**
+ * LibddcStoreHeader:
+ *
+ * The start of the file
+ **/
+typedef struct {
+	gchar			 magic[8];
+	guint32			 n_slots;
+	guint32			 reserved;
+} LibddcStoreHeader;
+
+/**
+ * LibddcStoreSlot:
+ *
+ * One control of one display
+ **/
+typedef struct {
+	volatile gint		 seq;
+	guint8			 used;
+	guint8			 id;
+	guint16			 value;
+	guint8			 md5[16];
+	guint16			 maximum;
+	guint16			 reserved;
+	gint64			 timestamp;
+} LibddcStoreSlot;
+
+/**
+ * LibddcStorePrivate:
+ *
+ * Private #LibddcStore data
+ **/
+struct _LibddcStorePrivate
+{
+	gint			 fd;
+	gpointer		 map;
+	gsize			 size;
+	LibddcStoreSlot		*slots;
+};
+
+G_DEFINE_TYPE (LibddcStore, libddc_store, G_TYPE_OBJECT)
+
+/**
+ * libddc_store_parse_md5:
+ **/
+static gboolean
+libddc_store_parse_md5 (const gchar *edid_md5, guint8 *md5)
+{
+	guint i;
+	gint hi, lo;
+
+	if (edid_md5 == NULL || strlen (edid_md5) != 32)
+		return FALSE;
+	for (i=0; i<16; i++) {
+		hi = g_ascii_xdigit_value (edid_md5[i * 2]);
+		lo = g_ascii_xdigit_value (edid_md5[i * 2 + 1]);
+		if (hi < 0 || lo < 0)
+			return FALSE;
+		md5[i] = (hi << 4) | lo;
+	}
+	return TRUE;
+}
+
+/**
+ * libddc_store_hash:
+ **/
+static guint
+libddc_store_hash (const guint8 *md5, guchar id)
+{
+	guint i;
+	guint hash = id;
+
+	for (i=0; i<16; i++)
+		hash = hash * 31 + md5[i];
+	return hash;
+}
+
+/**
+ * libddc_store_slot_lock:
+ *
+ * Waits for any other writer to finish with the slot. A writer that holds
+ * it for the whole wait without any progress has crashed, so the slot is
+ * taken over rather than being skipped.
+ *
+ * Return value: the odd sequence number to unlock with, or 0 on failure
+ **/
+static gint
+libddc_store_slot_lock (LibddcStoreSlot *slot)
+{
+	guint i;
+	gint seq;
+	gint seq_first;
+
+	seq_first = g_atomic_int_get (&slot->seq);
+	for (i=0; i<LIBDDC_STORE_SPINS; i++) {
+		seq = g_atomic_int_get (&slot->seq);
+		if ((seq & 1) == 0 &&
+		    g_atomic_int_compare_and_exchange (&slot->seq, seq, seq + 1))
+			return seq + 1;
+		g_thread_yield ();
+	}
+
+	/* keep the sequence odd so readers still skip it */
+	if ((seq_first & 1) == 1 &&
+	    g_atomic_int_compare_and_exchange (&slot->seq, seq_first, seq_first + 2))
+		return seq_first + 2;
+	return 0;
+}
+
+/**
+ * libddc_store_slot_unlock:
+ **/
+static void
+libddc_store_slot_unlock (LibddcStoreSlot *slot, gint seq)
+{
+	g_atomic_int_set (&slot->seq, seq + 1);
+}
+
+/**
+ * libddc_store_slot_write:
+ **/
+static void
+libddc_store_slot_write (LibddcStoreSlot *slot, const guint8 *md5, guchar id,
+			 guint16 value, guint16 maximum)
+{
+	memcpy (slot->md5, md5, sizeof (slot->md5));
+	slot->id = id;
+	slot->value = value;
+	slot->maximum = maximum;
+	slot->timestamp = g_get_real_time ();
+	slot->used = TRUE;
+}
+
+/**
+ * libddc_store_update:
+ * @store: a #LibddcStore
+ * @edid_md5: the EDID hash of the display
+ * @id: the control ID
+ * @value: the value that was read or written
+ * @maximum: the maximum of the control, or 0 if not known
+ *
+ * Records a control value for other processes to find.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_store_update (LibddcStore *store, const gchar *edid_md5, guchar id,
+		     guint16 value, guint16 maximum)
+{
+	gint seq;
+	gint64 oldest_time;
+	guint hash;
+	guint i;
+	guint retry;
+	guint8 md5[16];
+	LibddcStoreSlot *oldest;
+	LibddcStoreSlot *slot;
+
+	g_return_if_fail (LIBDDC_IS_STORE(store));
+
+	if (store->priv->slots == NULL)
+		return;
+	if (!libddc_store_parse_md5 (edid_md5, md5))
+		return;
+
+	hash = libddc_store_hash (md5, id);
+	for (retry=0; retry<LIBDDC_STORE_RETRIES; retry++) {
+		oldest = NULL;
+		oldest_time = G_MAXINT64;
+		for (i=0; i<LIBDDC_STORE_PROBES; i++) {
+			slot = &store->priv->slots[(hash + i) % LIBDDC_STORE_SLOTS];
+
+			/* a busy slot may be this key, so it cannot be skipped
+			 * without risking a second copy further along */
+			seq = libddc_store_slot_lock (slot);
+			if (seq == 0)
+				return;
+
+			/* this key, or the end of the chain */
+			if (!slot->used ||
+			    (slot->id == id && memcmp (slot->md5, md5, sizeof (md5)) == 0)) {
+				libddc_store_slot_write (slot, md5, id, value, maximum);
+				libddc_store_slot_unlock (slot, seq);
+				return;
+			}
+			if (slot->timestamp < oldest_time) {
+				oldest_time = slot->timestamp;
+				oldest = slot;
+			}
+			libddc_store_slot_unlock (slot, seq);
+		}
+
+		/* all full, so replace the least recently used */
+		if (oldest == NULL)
+			return;
+		seq = libddc_store_slot_lock (oldest);
+		if (seq == 0)
+			return;
+
+		/* unless another writer got there first, in which case it may
+		 * now hold this key and the chain has to be searched again */
+		if (oldest->timestamp == oldest_time ||
+		    (oldest->id == id && memcmp (oldest->md5, md5, sizeof (md5)) == 0)) {
+			libddc_store_slot_write (oldest, md5, id, value, maximum);
+			libddc_store_slot_unlock (oldest, seq);
+			return;
+		}
+		libddc_store_slot_unlock (oldest, seq);
+	}
+}
+
+/**
+ * libddc_store_lookup:
+ * @store: a #LibddcStore
+ * @edid_md5: the EDID hash of the display
+ * @id: the control ID
+ * @value: (out): the last known value, or %NULL
+ * @maximum: (out): the last known maximum, or %NULL
+ * @timestamp: (out): when the value was recorded in microseconds since
+ * the epoch, or %NULL
+ *
+ * Finds a value recorded by this or any other process, without locking.
+ *
+ * Return value: %TRUE if a value was found
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_store_lookup (LibddcStore *store, const gchar *edid_md5, guchar id,
+		     guint16 *value, guint16 *maximum, gint64 *timestamp)
+{
+	gint seq;
+	guint hash;
+	guint i, j;
+	guint8 md5[16];
+	LibddcStoreSlot copy;
+	LibddcStoreSlot *slot;
+
+	g_return_val_if_fail (LIBDDC_IS_STORE(store), FALSE);
+
+	if (store->priv->slots == NULL)
+		return FALSE;
+	if (!libddc_store_parse_md5 (edid_md5, md5))
+		return FALSE;
+
+	hash = libddc_store_hash (md5, id);
+	for (i=0; i<LIBDDC_STORE_PROBES; i++) {
+		slot = &store->priv->slots[(hash + i) % LIBDDC_STORE_SLOTS];
+
+		/* copy until no writer changed it under us */
+		for (j=0; j<LIBDDC_STORE_SPINS; j++) {
+			seq = g_atomic_int_get (&slot->seq);
+			if ((seq & 1) == 0) {
+				memcpy (&copy, (gconstpointer) slot, sizeof (copy));
+				if (g_atomic_int_get (&slot->seq) == seq)
+					break;
+			}
+			g_thread_yield ();
+		}
+		if (j == LIBDDC_STORE_SPINS)
+			continue;
+
+		if (!copy.used)
+			return FALSE;
+		if (copy.id != id || memcmp (copy.md5, md5, sizeof (md5)) != 0)
+			continue;
+		if (value != NULL)
+			*value = copy.value;
+		if (maximum != NULL)
+			*maximum = copy.maximum;
+		if (timestamp != NULL)
+			*timestamp = copy.timestamp;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * libddc_store_open:
+ * @store: a #LibddcStore
+ * @filename: the state file, or %NULL for the default in the user runtime directory
+ * @error: a #GError, or %NULL
+ *
+ * Maps the state file, creating it if required.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_store_open (LibddcStore *store, const gchar *filename, GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *dirname = NULL;
+	gchar *filename_default = NULL;
+	gpointer map;
+	gsize size;
+	struct stat buf;
+	LibddcStoreHeader *header;
+
+	g_return_val_if_fail (LIBDDC_IS_STORE(store), FALSE);
+	g_return_val_if_fail (store->priv->map == NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (filename == NULL) {
+		filename_default = g_build_filename (g_get_user_runtime_dir (), "libddc", "state", NULL);
+		filename = filename_default;
+	}
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0700) < 0) {
+		g_set_error (error, LIBDDC_STORE_ERROR, LIBDDC_STORE_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		goto out;
+	}
+
+	store->priv->fd = g_open (filename, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (store->priv->fd < 0) {
+		g_set_error (error, LIBDDC_STORE_ERROR, LIBDDC_STORE_ERROR_FAILED,
+			     "failed to open %s", filename);
+		goto out;
+	}
+
+	/* a new file is all zeros */
+	size = sizeof (LibddcStoreHeader) + LIBDDC_STORE_SLOTS * sizeof (LibddcStoreSlot);
+	if (fstat (store->priv->fd, &buf) < 0 ||
+	    ((gsize) buf.st_size < size && ftruncate (store->priv->fd, size) < 0)) {
+		g_set_error (error, LIBDDC_STORE_ERROR, LIBDDC_STORE_ERROR_FAILED,
+			     "failed to resize %s", filename);
+		goto out;
+	}
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, store->priv->fd, 0);
+	if (map == MAP_FAILED) {
+		g_set_error (error, LIBDDC_STORE_ERROR, LIBDDC_STORE_ERROR_FAILED,
+			     "failed to map %s", filename);
+		goto out;
+	}
+	store->priv->map = map;
+	store->priv->size = size;
+
+	/* every process writes the same header, so racing here is fine */
+	header = (LibddcStoreHeader *) map;
+	if (header->magic[0] == '\0') {
+		header->n_slots = LIBDDC_STORE_SLOTS;
+		memcpy (header->magic, LIBDDC_STORE_MAGIC, sizeof (header->magic));
+	}
+	if (memcmp (header->magic, LIBDDC_STORE_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->n_slots != LIBDDC_STORE_SLOTS) {
+		g_set_error (error, LIBDDC_STORE_ERROR, LIBDDC_STORE_ERROR_FAILED,
+			     "%s is not a compatible state file", filename);
+		goto out;
+	}
+	store->priv->slots = (LibddcStoreSlot *) (header + 1);
+	ret = TRUE;
+out:
+	g_free (dirname);
+	g_free (filename_default);
+	return ret;
+}
+
+/**
+ * libddc_store_error_quark:
+ *
+ * Return value: Our personal error quark.
+ *
+ * Since: 0.0.1
+ **/
+GQuark
+libddc_store_error_quark (void)
+{
+	static GQuark quark = 0;
+	if (!quark)
+		quark = g_quark_from_static_string ("libddc_store_error");
+	return quark;
+}
+
+/**
+ * libddc_store_class_init:
+ **/
+static void
+libddc_store_class_init (LibddcStoreClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_store_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcStorePrivate));
+}
+
+/**
+ * libddc_store_init:
+ **/
+static void
+libddc_store_init (LibddcStore *store)
+{
+	store->priv = LIBDDC_STORE_GET_PRIVATE (store);
+	store->priv->fd = -1;
+}
+
+/**
+ * libddc_store_finalize:
+ **/
+static void
+libddc_store_finalize (GObject *object)
+{
+	LibddcStore *store = LIBDDC_STORE (object);
+	LibddcStorePrivate *priv = store->priv;
+
+	g_return_if_fail (LIBDDC_IS_STORE(store));
+
+	if (priv->map != NULL)
+		munmap (priv->map, priv->size);
+	if (priv->fd >= 0)
+		close (priv->fd);
+
+	G_OBJECT_CLASS (libddc_store_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_store_new:
+ *
+ * Return value: A new %LibddcStore instance
+ *
+ * Since: 0.0.1
+ **/
+LibddcStore *
+libddc_store_new (void)
+{
+	LibddcStore *store;
+	store = g_object_new (LIBDDC_TYPE_STORE, NULL);
+	return LIBDDC_STORE (store);
+}
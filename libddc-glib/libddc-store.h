@@ -0,0 +1,96 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_STORE_H
+#define __LIBDDC_STORE_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_STORE		(libddc_store_get_type ())
+#define LIBDDC_STORE(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_STORE, LibddcStore))
+#define LIBDDC_STORE_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_STORE, LibddcStoreClass))
+#define LIBDDC_IS_STORE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_STORE))
+#define LIBDDC_IS_STORE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_STORE))
+#define LIBDDC_STORE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_STORE, LibddcStoreClass))
+#define LIBDDC_STORE_ERROR		(libddc_store_error_quark ())
+
+/**
+ * LibddcStoreError:
+ * @LIBDDC_STORE_ERROR_FAILED: the state file could not be used
+ *
+ * Errors that can be thrown
+ */
+typedef enum
+{
+	LIBDDC_STORE_ERROR_FAILED
+} LibddcStoreError;
+
+typedef struct _LibddcStorePrivate		LibddcStorePrivate;
+typedef struct _LibddcStore			LibddcStore;
+typedef struct _LibddcStoreClass		LibddcStoreClass;
+
+struct _LibddcStore
+{
+	 GObject		 parent;
+	 LibddcStorePrivate	*priv;
+};
+
+struct _LibddcStoreClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GQuark		 libddc_store_error_quark		(void);
+GType		 libddc_store_get_type			(void);
+LibddcStore	*libddc_store_new			(void);
+
+gboolean	 libddc_store_open			(LibddcStore	*store,
+							 const gchar	*filename,
+							 GError		**error);
+void		 libddc_store_update			(LibddcStore	*store,
+							 const gchar	*edid_md5,
+							 guchar		 id,
+							 guint16	 value,
+							 guint16	 maximum);
+gboolean	 libddc_store_lookup			(LibddcStore	*store,
+							 const gchar	*edid_md5,
+							 guchar		 id,
+							 guint16	*value,
+							 guint16	*maximum,
+							 gint64		*timestamp);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_STORE_H */
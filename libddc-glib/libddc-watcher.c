@@ -0,0 +1,486 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:libddc-watcher
+ * @short_description: Notices controls changed on the display itself
+ *
+ * Polling every interesting control to notice changes made with the
+ * buttons on the display costs one round trip per control per interval.
+ * MCCS displays instead raise the New Control Value control when anything
+ * changes, and queue the changed control codes in the Active Control FIFO.
+ * The watcher only polls the former, and when set drains the latter,
+ * re-reading just the controls that changed and emitting
+ * #LibddcControl::changed on each of them.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include <libddc-control.h>
+#include <libddc-device.h>
+#include <libddc-watcher.h>
+
+static void     libddc_watcher_finalize	(GObject     *object);
+
+#define LIBDDC_WATCHER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), LIBDDC_TYPE_WATCHER, LibddcWatcherPrivate))
+
+/* the New Control Value control */
+#define LIBDDC_WATCHER_NO_NEW_VALUES		0x01
+#define LIBDDC_WATCHER_NEW_VALUES		0x02
+
+/* the Active Control FIFO */
+#define LIBDDC_WATCHER_FIFO_EMPTY		0x00
+#define LIBDDC_WATCHER_FIFO_MAX			0xff
+
+#define LIBDDC_WATCHER_DEFAULT_INTERVAL		1000 /* ms */
+
+/**
+ * LibddcWatcherPrivate:
+ *
+ * Private #LibddcWatcher data
+ **/
+struct _LibddcWatcherPrivate
+{
+	LibddcDevice		*device;
+	guint			 interval;
+	guint			 timeout_id;
+	GCancellable		*cancellable;
+	guint			 fifo_reads;
+};
+
+G_DEFINE_TYPE (LibddcWatcher, libddc_watcher, G_TYPE_OBJECT)
+
+/**
+ * libddc_watcher_read:
+ *
+ * Reads one control the display may not have advertised
+ **/
+static gboolean
+libddc_watcher_read (LibddcWatcher *watcher, guchar id, guint16 *value, GError **error)
+{
+	LibddcPollItem item;
+
+	item.id = id;
+	if (libddc_device_poll (watcher->priv->device, &item, 1) != 1) {
+		g_set_error (error, LIBDDC_WATCHER_ERROR, LIBDDC_WATCHER_ERROR_FAILED,
+			     "failed to read control 0x%02x", id);
+		return FALSE;
+	}
+	*value = item.value;
+	return TRUE;
+}
+
+/**
+ * libddc_watcher_check:
+ * @watcher: a #LibddcWatcher
+ * @changed: (out): the number of controls that changed, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Asks the display if any controls were changed since the last check,
+ * and emits #LibddcControl::changed for each one that was.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.0.1
+ **/
+gboolean
+libddc_watcher_check (LibddcWatcher *watcher, guint *changed, GError **error)
+{
+	gboolean ret;
+	guchar buf[4];
+	guint i;
+	guint n_changed = 0;
+	guint16 value;
+	GError *error_local = NULL;
+	LibddcControl *control;
+	LibddcWatcherPrivate *priv = watcher->priv;
+
+	g_return_val_if_fail (LIBDDC_IS_WATCHER(watcher), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* the usual case is a single round trip */
+	ret = libddc_watcher_read (watcher, LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE, &value, error);
+	if (!ret)
+		goto out;
+	if (value != LIBDDC_WATCHER_NEW_VALUES)
+		goto out;
+
+	/* drain the FIFO, bounded in case the display never empties it */
+	for (i=0; i<LIBDDC_WATCHER_FIFO_MAX; i++) {
+		ret = libddc_watcher_read (watcher, LIBDDC_CONTROL_ID_ACTIVE_CONTROL, &value, error);
+		if (!ret)
+			goto out;
+		value &= 0xff;
+		if (value == LIBDDC_WATCHER_FIFO_EMPTY)
+			break;
+
+		/* the display may report controls it did not advertise */
+		control = libddc_device_get_control_by_id (priv->device, value, NULL);
+		if (control == NULL)
+			continue;
+		ret = libddc_control_request_full (control, LIBDDC_CONTROL_REQUEST_FLAG_FORCE,
+						   &value, NULL, &error_local);
+		if (!ret) {
+			g_warning ("failed to read changed control 0x%02x: %s",
+				   libddc_control_get_id (control), error_local->message);
+			g_clear_error (&error_local);
+		} else {
+			g_signal_emit_by_name (control, "changed", (guint) value);
+			n_changed++;
+		}
+		g_object_unref (control);
+	}
+
+	/* tell the display we have seen everything */
+	buf[0] = LIBDDC_VCP_SET;
+	buf[1] = LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE;
+	buf[2] = 0x00;
+	buf[3] = LIBDDC_WATCHER_NO_NEW_VALUES;
+	ret = libddc_device_command (priv->device, buf, sizeof(buf), NULL, 0, NULL, error);
+out:
+	if (ret && changed != NULL)
+		*changed = n_changed;
+	return ret;
+}
+
+static void libddc_watcher_request_cb (GObject *source, GAsyncResult *res, gpointer user_data);
+
+/**
+ * libddc_watcher_check_done:
+ *
+ * Finishes a check started from the main loop
+ **/
+static void
+libddc_watcher_check_done (LibddcWatcher *watcher)
+{
+	g_clear_object (&watcher->priv->cancellable);
+	g_object_unref (watcher);
+}
+
+/**
+ * libddc_watcher_request_async:
+ **/
+static void
+libddc_watcher_request_async (LibddcWatcher *watcher, guchar id)
+{
+	guchar buf[2];
+
+	buf[0] = LIBDDC_VCP_REQUEST;
+	buf[1] = id;
+	libddc_device_command_async (watcher->priv->device, buf, sizeof(buf), 8,
+				     watcher->priv->cancellable,
+				     libddc_watcher_request_cb, watcher);
+}
+
+/**
+ * libddc_watcher_ack_cb:
+ **/
+static void
+libddc_watcher_ack_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GBytes *bytes;
+	GError *error = NULL;
+	LibddcWatcher *watcher = LIBDDC_WATCHER (user_data);
+
+	bytes = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_debug ("failed to check for changes: %s", error->message);
+		g_error_free (error);
+	} else {
+		g_bytes_unref (bytes);
+	}
+	libddc_watcher_check_done (watcher);
+}
+
+/**
+ * libddc_watcher_next_async:
+ *
+ * Reads the next entry in the FIFO, or says we have seen everything
+ **/
+static void
+libddc_watcher_next_async (LibddcWatcher *watcher, gboolean empty)
+{
+	guchar buf[4];
+
+	/* bounded in case the display never empties it */
+	if (!empty && watcher->priv->fifo_reads++ < LIBDDC_WATCHER_FIFO_MAX) {
+		libddc_watcher_request_async (watcher, LIBDDC_CONTROL_ID_ACTIVE_CONTROL);
+		return;
+	}
+	buf[0] = LIBDDC_VCP_SET;
+	buf[1] = LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE;
+	buf[2] = 0x00;
+	buf[3] = LIBDDC_WATCHER_NO_NEW_VALUES;
+	libddc_device_command_async (watcher->priv->device, buf, sizeof(buf), 0,
+				     watcher->priv->cancellable,
+				     libddc_watcher_ack_cb, watcher);
+}
+
+/**
+ * libddc_watcher_changed_cb:
+ **/
+static void
+libddc_watcher_changed_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	guint16 value;
+	GError *error = NULL;
+	LibddcControl *control = LIBDDC_CONTROL (source);
+	LibddcWatcher *watcher = LIBDDC_WATCHER (user_data);
+
+	if (!libddc_control_request_finish (control, res, &value, NULL, &error)) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			libddc_watcher_check_done (watcher);
+			return;
+		}
+		g_warning ("failed to read changed control 0x%02x: %s",
+			   libddc_control_get_id (control), error->message);
+		g_error_free (error);
+	} else {
+		g_signal_emit_by_name (control, "changed", (guint) value);
+	}
+	g_object_unref (control);
+	libddc_watcher_next_async (watcher, FALSE);
+}
+
+/**
+ * libddc_watcher_request_cb:
+ **/
+static void
+libddc_watcher_request_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	gsize len;
+	const guchar *buf;
+	guint16 value;
+	GBytes *bytes;
+	GError *error = NULL;
+	LibddcControl *control;
+	LibddcWatcher *watcher = LIBDDC_WATCHER (user_data);
+
+	bytes = libddc_device_command_finish (LIBDDC_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_debug ("failed to check for changes: %s", error->message);
+		g_error_free (error);
+		libddc_watcher_check_done (watcher);
+		return;
+	}
+
+	/* the same checks as libddc_device_poll() */
+	buf = g_bytes_get_data (bytes, &len);
+	if (len != 8 || buf[0] != LIBDDC_VCP_REPLY || buf[1] != 0) {
+		g_debug ("failed to check for changes: invalid reply");
+		g_bytes_unref (bytes);
+		libddc_watcher_check_done (watcher);
+		return;
+	}
+	value = buf[6] * 256 + buf[7];
+
+	/* the usual case is a single round trip */
+	if (buf[2] == LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE) {
+		g_bytes_unref (bytes);
+		if (value != LIBDDC_WATCHER_NEW_VALUES) {
+			libddc_watcher_check_done (watcher);
+			return;
+		}
+		watcher->priv->fifo_reads = 0;
+		libddc_watcher_next_async (watcher, FALSE);
+		return;
+	}
+	g_bytes_unref (bytes);
+	value &= 0xff;
+	if (value == LIBDDC_WATCHER_FIFO_EMPTY) {
+		libddc_watcher_next_async (watcher, TRUE);
+		return;
+	}
+
+	/* the capabilities were read before the first command was sent, so
+	 * this never touches the bus */
+	control = libddc_device_get_control_by_id (watcher->priv->device, value, NULL);
+	if (control == NULL) {
+		libddc_watcher_next_async (watcher, FALSE);
+		return;
+	}
+	libddc_control_request_async (control, watcher->priv->cancellable,
+				      libddc_watcher_changed_cb, watcher);
+}
+
+/**
+ * libddc_watcher_timeout_cb:
+ *
+ * Every transfer is queued on the device, so the main loop never waits
+ * for the display
+ **/
+static gboolean
+libddc_watcher_timeout_cb (gpointer user_data)
+{
+	LibddcWatcher *watcher = LIBDDC_WATCHER (user_data);
+
+	/* the last check is still going */
+	if (watcher->priv->cancellable != NULL)
+		return TRUE;
+	watcher->priv->cancellable = g_cancellable_new ();
+	g_object_ref (watcher);
+	libddc_watcher_request_async (watcher, LIBDDC_CONTROL_ID_NEW_CONTROL_VALUE);
+	return TRUE;
+}
+
+/**
+ * libddc_watcher_set_interval:
+ * @watcher: a #LibddcWatcher
+ * @interval: the time between checks in milliseconds
+ *
+ * Sets how often libddc_watcher_start() asks the display for changes.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_watcher_set_interval (LibddcWatcher *watcher, guint interval)
+{
+	g_return_if_fail (LIBDDC_IS_WATCHER(watcher));
+	g_return_if_fail (interval > 0);
+
+	watcher->priv->interval = interval;
+	if (watcher->priv->timeout_id != 0) {
+		libddc_watcher_stop (watcher);
+		libddc_watcher_start (watcher);
+	}
+}
+
+/**
+ * libddc_watcher_start:
+ * @watcher: a #LibddcWatcher
+ *
+ * Checks for changes periodically from the default main context, like
+ * libddc_watcher_check() but without blocking it.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_watcher_start (LibddcWatcher *watcher)
+{
+	g_return_if_fail (LIBDDC_IS_WATCHER(watcher));
+
+	if (watcher->priv->timeout_id != 0)
+		return;
+	watcher->priv->timeout_id = g_timeout_add (watcher->priv->interval,
+						   libddc_watcher_timeout_cb, watcher);
+}
+
+/**
+ * libddc_watcher_stop:
+ * @watcher: a #LibddcWatcher
+ *
+ * Stops checking for changes.
+ *
+ * Since: 0.0.1
+ **/
+void
+libddc_watcher_stop (LibddcWatcher *watcher)
+{
+	g_return_if_fail (LIBDDC_IS_WATCHER(watcher));
+
+	if (watcher->priv->timeout_id == 0)
+		return;
+	g_source_remove (watcher->priv->timeout_id);
+	watcher->priv->timeout_id = 0;
+
+	/* finishes the next time the device gets to it */
+	if (watcher->priv->cancellable != NULL)
+		g_cancellable_cancel (watcher->priv->cancellable);
+}
+
+/**
+ * libddc_watcher_error_quark:
+ *
+ * Return value: Our personal error quark.
+ *
+ * Since: 0.0.1
+ **/
+GQuark
+libddc_watcher_error_quark (void)
+{
+	static GQuark quark = 0;
+	if (!quark)
+		quark = g_quark_from_static_string ("libddc_watcher_error");
+	return quark;
+}
+
+/**
+ * libddc_watcher_class_init:
+ **/
+static void
+libddc_watcher_class_init (LibddcWatcherClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = libddc_watcher_finalize;
+
+	g_type_class_add_private (klass, sizeof (LibddcWatcherPrivate));
+}
+
+/**
+ * libddc_watcher_init:
+ **/
+static void
+libddc_watcher_init (LibddcWatcher *watcher)
+{
+	watcher->priv = LIBDDC_WATCHER_GET_PRIVATE (watcher);
+	watcher->priv->interval = LIBDDC_WATCHER_DEFAULT_INTERVAL;
+}
+
+/**
+ * libddc_watcher_finalize:
+ **/
+static void
+libddc_watcher_finalize (GObject *object)
+{
+	LibddcWatcher *watcher = LIBDDC_WATCHER (object);
+	LibddcWatcherPrivate *priv = watcher->priv;
+
+	g_return_if_fail (LIBDDC_IS_WATCHER(watcher));
+
+	libddc_watcher_stop (watcher);
+	if (priv->device != NULL)
+		g_object_unref (priv->device);
+
+	G_OBJECT_CLASS (libddc_watcher_parent_class)->finalize (object);
+}
+
+/**
+ * libddc_watcher_new:
+ * @device: a #LibddcDevice
+ *
+ * Return value: A new %LibddcWatcher instance for @device
+ *
+ * Since: 0.0.1
+ **/
+LibddcWatcher *
+libddc_watcher_new (LibddcDevice *device)
+{
+	LibddcWatcher *watcher;
+
+	g_return_val_if_fail (LIBDDC_IS_DEVICE(device), NULL);
+
+	watcher = g_object_new (LIBDDC_TYPE_WATCHER, NULL);
+	watcher->priv->device = g_object_ref (device);
+	return LIBDDC_WATCHER (watcher);
+}
@@ -0,0 +1,91 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__LIBDDC_H_INSIDE__) && !defined (LIBDDC_COMPILATION)
+#error "Only <libddc.h> can be included directly."
+#endif
+
+#ifndef __LIBDDC_WATCHER_H
+#define __LIBDDC_WATCHER_H
+
+#include <glib-object.h>
+
+#include <libddc-common.h>
+#include <libddc-device.h>
+
+G_BEGIN_DECLS
+
+#define LIBDDC_TYPE_WATCHER		(libddc_watcher_get_type ())
+#define LIBDDC_WATCHER(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), LIBDDC_TYPE_WATCHER, LibddcWatcher))
+#define LIBDDC_WATCHER_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), LIBDDC_TYPE_WATCHER, LibddcWatcherClass))
+#define LIBDDC_IS_WATCHER(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), LIBDDC_TYPE_WATCHER))
+#define LIBDDC_IS_WATCHER_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), LIBDDC_TYPE_WATCHER))
+#define LIBDDC_WATCHER_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), LIBDDC_TYPE_WATCHER, LibddcWatcherClass))
+#define LIBDDC_WATCHER_ERROR		(libddc_watcher_error_quark ())
+
+/**
+ * LibddcWatcherError:
+ * @LIBDDC_WATCHER_ERROR_FAILED: the transaction failed for an unknown reason
+ *
+ * Errors that can be thrown
+ */
+typedef enum
+{
+	LIBDDC_WATCHER_ERROR_FAILED
+} LibddcWatcherError;
+
+typedef struct _LibddcWatcherPrivate		LibddcWatcherPrivate;
+typedef struct _LibddcWatcher			LibddcWatcher;
+typedef struct _LibddcWatcherClass		LibddcWatcherClass;
+
+struct _LibddcWatcher
+{
+	 GObject		 parent;
+	 LibddcWatcherPrivate	*priv;
+};
+
+struct _LibddcWatcherClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_libddc_reserved1) (void);
+	void (*_libddc_reserved2) (void);
+	void (*_libddc_reserved3) (void);
+	void (*_libddc_reserved4) (void);
+	void (*_libddc_reserved5) (void);
+};
+
+GQuark		 libddc_watcher_error_quark		(void);
+GType		 libddc_watcher_get_type		(void);
+LibddcWatcher	*libddc_watcher_new			(LibddcDevice	*device);
+
+void		 libddc_watcher_set_interval		(LibddcWatcher	*watcher,
+							 guint		 interval);
+gboolean	 libddc_watcher_check			(LibddcWatcher	*watcher,
+							 guint		*changed,
+							 GError		**error);
+void		 libddc_watcher_start			(LibddcWatcher	*watcher);
+void		 libddc_watcher_stop			(LibddcWatcher	*watcher);
+
+G_END_DECLS
+
+#endif /* __LIBDDC_WATCHER_H */
+
@@ -32,6 +32,12 @@
 #include <libddc-device.h>
 #include <libddc-client.h>
 #include <libddc-control.h>
+#include <libddc-simulator.h>
+#include <libddc-scheduler.h>
+#include <libddc-batch.h>
+#include <libddc-snapshot.h>
+#include <libddc-store.h>
+#include <libddc-watcher.h>
 
 #undef __LIBDDC_H_INSIDE__
 
@@ -24,6 +24,9 @@
 
 #include <libddc.h>
 
+/* how old the remembered brightness can be before we ask the display */
+#define LIBDDC_UTIL_BRIGHTNESS_MAX_AGE		5000 /* ms */
+
 /**
  * show_device_md5_cb:
  **/
@@ -73,6 +76,10 @@ show_device (LibddcDevice *device)
 	}
 	g_print ("PNPID:\t%s\n", desc);
 
+	desc = libddc_device_get_connector (device);
+	if (desc != NULL)
+		g_print ("Output:\t%s\n", desc);
+
 	desc = libddc_device_get_model (device, &error);
 	if (desc == NULL) {
 		g_warning ("failed to get model: %s", error->message);
@@ -119,6 +126,47 @@ show_device_cb (LibddcDevice *device, gpointer user_data)
 	show_device (device);
 }
 
+/**
+ * show_stats:
+ **/
+static void
+show_stats (LibddcDevice *device)
+{
+	guint i, j;
+	guint errors, retries;
+	guint64 limit;
+	LibddcDeviceStats stats;
+
+	for (i=0; i<LIBDDC_DEVICE_STATS_KIND_LAST; i++) {
+		libddc_device_get_stats (device, i, &stats);
+		if (stats.transactions == 0)
+			continue;
+		g_print ("%s:\n", libddc_device_stats_kind_to_string (i));
+		g_print ("\ttransactions:\t%u\n", stats.transactions);
+		g_print ("\tbytes-written:\t%" G_GUINT64_FORMAT "\n", stats.bytes_written);
+		g_print ("\tbytes-read:\t%" G_GUINT64_FORMAT "\n", stats.bytes_read);
+		g_print ("\tsleep-time:\t%" G_GUINT64_FORMAT "us\n", stats.sleep_time);
+		g_print ("\tbus-time:\t%" G_GUINT64_FORMAT "us\n", stats.bus_time);
+		g_print ("\thistogram:\tsleep\tbus\n");
+		for (j=0; j<LIBDDC_DEVICE_STATS_BUCKETS; j++) {
+			limit = libddc_device_get_stats_bucket_limit (j);
+			if (limit == G_MAXUINT64)
+				g_print ("\t  >= %" G_GUINT64_FORMAT "us", libddc_device_get_stats_bucket_limit (j - 1));
+			else
+				g_print ("\t  < %" G_GUINT64_FORMAT "us", limit);
+			g_print ("\t%u\t%u\n", stats.sleep_histogram[j], stats.bus_histogram[j]);
+		}
+	}
+
+	/* errors and retries are counted per error kind */
+	for (i=0; i<LIBDDC_DEVICE_ERROR_LAST; i++) {
+		libddc_device_get_retry_stats (device, i, &errors, &retries);
+		if (errors == 0)
+			continue;
+		g_print ("error %s:\t%u (%u retried)\n", libddc_device_error_to_string (i), errors, retries);
+	}
+}
+
 /**
  * main:
  **/
@@ -133,9 +181,13 @@ main (int argc, char **argv)
 	gchar *control_name = NULL;
 	gboolean control_get = FALSE;
 	gint control_set = -1;
+	gboolean calibrate = FALSE;
+	gboolean stats = FALSE;
+	gdouble read_delay, write_delay;
 	LibddcClient *client;
 	LibddcDevice *device = NULL;
 	LibddcControl *control = NULL;
+	LibddcStore *store = NULL;
 	gint brightness = -1;
 	GOptionContext *context;
 	GError *error = NULL;
@@ -161,6 +213,10 @@ main (int argc, char **argv)
 		  "Get a control value", NULL},
 		{ "set", '\0', 0, G_OPTION_ARG_INT, &control_set,
 		  "Set a control value", NULL},
+		{ "calibrate", '\0', 0, G_OPTION_ARG_NONE, &calibrate,
+		  "Find and save the fastest reliable timings for the selected display", NULL},
+		{ "stats", '\0', 0, G_OPTION_ARG_NONE, &stats,
+		  "Show transaction counters for the selected display when done", NULL},
 		{ NULL}
 	};
 
@@ -216,6 +272,19 @@ main (int argc, char **argv)
 		goto out;
 	}
 
+	/* calibrate? */
+	if (calibrate) {
+		ret = libddc_device_calibrate (device, &error);
+		if (!ret) {
+			g_warning ("failed to calibrate: %s", error->message);
+			goto out;
+		}
+		libddc_device_get_delays (device, &read_delay, &write_delay);
+		g_print ("read delay is now %.1fms, write delay is now %.1fms\n",
+			 read_delay * 1000, write_delay * 1000);
+		goto out;
+	}
+
 	/* set brightness? */
 	if (brightness != -1) {
 		control = libddc_device_get_control_by_id (device, LIBDDC_CONTROL_ID_BRIGHTNESS, &error);
@@ -224,8 +293,21 @@ main (int argc, char **argv)
 			goto out;
 		}
 
+		/* the old value is only informational, so use what any
+		 * process saw recently rather than doing a round trip */
+		store = libddc_store_new ();
+		ret = libddc_store_open (store, NULL, &error);
+		if (ret) {
+			libddc_device_set_store (device, store);
+		} else {
+			g_debug ("failed to open store: %s", error->message);
+			g_clear_error (&error);
+		}
+		libddc_control_set_max_age (control, LIBDDC_UTIL_BRIGHTNESS_MAX_AGE);
+
 		/* get old value */
-		ret = libddc_control_request (control, &value, &max, &error);
+		ret = libddc_control_request_full (control, LIBDDC_CONTROL_REQUEST_FLAG_NONE,
+						   &value, &max, &error);
 		if (!ret) {
 			g_warning ("failed to read: %s", error->message);
 			goto out;
@@ -292,6 +374,8 @@ main (int argc, char **argv)
 		}
 	}
 out:
+	if (stats && device != NULL)
+		show_stats (device);
 	g_clear_error (&error);
 	ret = libddc_client_close (client, &error);
 	if (!ret) {
@@ -303,6 +387,8 @@ out:
 		g_object_unref (device);
 	if (control != NULL)
 		g_object_unref (control);
+	if (store != NULL)
+		g_object_unref (store);
 	g_object_unref (client);
 	g_free (display_md5);
 	g_free (control_name);